@@ -0,0 +1,11 @@
+// global bindless heap, set 0. bindings must match BindlessType in vk_bindless.h
+// resources are reached by the index their slot was given on the cpu, usually pushed as a constant
+
+[[vk::binding(0, 0)]] Texture2D sampledImages[];
+
+// storage imgs need their format in the declaration, alias the binding for other formats
+[[vk::binding(1, 0)]] [[vk::image_format("rgba16f")]] RWTexture2D<float4> storageImages[];
+
+[[vk::binding(2, 0)]] SamplerState samplers[];
+
+[[vk::binding(3, 0)]] RWByteAddressBuffer storageBuffers[];
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# packs compiled spir-v for the engine, see src/renderer/vk_shaders.h
+#   --header out.h in.spv...   c++ arrays compiled into the binary
+#   --archive out.pak in.spv... one file the engine maps at runtime
+import argparse
+import os
+import struct
+import sys
+
+ARCHIVE_MAGIC = 0x41565053  # "SPVA"
+ARCHIVE_VERSION = 1
+NAME_SIZE = 56
+SPIRV_MAGIC = 0x07230203
+
+
+def read_spirv(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) % 4 or len(data) < 20 or struct.unpack_from('<I', data)[0] != SPIRV_MAGIC:
+        sys.exit(f'{path} is not little endian spir-v')
+    return data
+
+
+def identifier(name):
+    return 'spv_' + ''.join(c if c.isalnum() else '_' for c in name)
+
+
+def write_header(out, inputs):
+    lines = [
+        '// generated by shaders/embed_spirv.py, do not edit',
+        '#pragma once',
+        '#include <cstdint>',
+        '',
+        'namespace embedded_shaders {',
+        'struct Shader {',
+        '    const char* name;',
+        '    const uint32_t* code;',
+        '    uint32_t words;',
+        '};',
+        '',
+    ]
+    table = []
+    for path in inputs:
+        name = os.path.basename(path)
+        data = read_spirv(path)
+        words = struct.unpack(f'<{len(data) // 4}I', data)
+        lines.append(f'alignas(4) inline constexpr uint32_t {identifier(name)}[] = {{')
+        for i in range(0, len(words), 8):
+            lines.append('    ' + ' '.join(f'0x{w:08x},' for w in words[i:i + 8]))
+        lines.append('};')
+        lines.append('')
+        table.append(f'    {{ "{name}", {identifier(name)}, {len(words)} }},')
+
+    # the empty entry keeps the array valid when nothing is embedded
+    lines.append('inline constexpr Shader SHADERS[] = {')
+    lines += table
+    lines.append('    { nullptr, nullptr, 0 },')
+    lines.append('};')
+    lines.append('} // namespace embedded_shaders')
+    lines.append('')
+
+    with open(out, 'w', newline='\n') as f:
+        f.write('\n'.join(lines))
+
+
+def write_archive(out, inputs):
+    entries = []
+    blobs = []
+    offset = 12 + 64 * len(inputs)
+    for path in inputs:
+        name = os.path.basename(path).encode()
+        if len(name) > NAME_SIZE:
+            sys.exit(f'{path}: name is longer than {NAME_SIZE} bytes')
+        data = read_spirv(path)
+        entries.append(struct.pack(f'<{NAME_SIZE}sII', name, offset, len(data) // 4))
+        blobs.append(data)
+        offset += len(data)
+
+    with open(out, 'wb') as f:
+        f.write(struct.pack('<III', ARCHIVE_MAGIC, ARCHIVE_VERSION, len(inputs)))
+        for entry in entries:
+            f.write(entry)
+        for blob in blobs:
+            f.write(blob)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    mode = parser.add_mutually_exclusive_group(required=True)
+    mode.add_argument('--header')
+    mode.add_argument('--archive')
+    parser.add_argument('inputs', nargs='*')
+    args = parser.parse_args()
+
+    if args.header:
+        write_header(args.header, args.inputs)
+    else:
+        write_archive(args.archive, args.inputs)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,27 +1,40 @@
+#include "bindless.hlsli"
 
-// bind RWTexture2D for rgba16f
-// "u" register is for UAVs, "space0" corresponds to set 0
-RWTexture2D<float4> image : register(u0, space0);
+// GradientPushConstants in vk_renderer.h
+struct PushConstants {
+    uint drawImg; // storage img slot to write into
+    float time; // seconds
+    uint2 extent; // draw extent, the img itself can be bigger
+};
 
-[numthreads(16, 16, 1)]
+[[vk::push_constant]] PushConstants pc;
+
+// workgroup size is picked per device at startup (see WorkgroupTuner), these are only the defaults
+[[vk::constant_id(0)]] const uint GROUP_SIZE_X = 16;
+[[vk::constant_id(1)]] const uint GROUP_SIZE_Y = 16;
+// black lines along each group's first row and column
+[[vk::constant_id(2)]] const bool GRID_LINES = true;
+
+[numthreads(GROUP_SIZE_X, GROUP_SIZE_Y, 1)]
 void main(uint3 dispatchThreadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupThreadID)
 {
     int2 texelCoord = int2(dispatchThreadID.xy); // equivalent to gl_GlobalInvocationID.xy
 
-    uint width, height;
-    image.GetDimensions(width, height);
-    int2 size = int2(width, height);
+    RWTexture2D<float4> image = storageImages[pc.drawImg];
+
+    int2 size = int2(pc.extent);
 
     if (texelCoord.x < size.x && texelCoord.y < size.y)
     {
         float4 color = float4(0.0, 0.0, 0.0, 1.0);
 
-        if (groupThreadID.x != 0 && groupThreadID.y != 0)
+        if (!GRID_LINES || (groupThreadID.x != 0 && groupThreadID.y != 0))
         {
             color.x = float(texelCoord.x) / float(size.x);
             color.y = float(texelCoord.y) / float(size.y);
+            color.z = 0.5 + 0.5 * sin(pc.time);
         }
 
         image[texelCoord] = color;
     }
-}
\ No newline at end of file
+}
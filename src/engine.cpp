@@ -1,4 +1,5 @@
 #include "engine.h"
+#include "renderer/vk_bench.h"
 #include <thread>
 #include <chrono>
 
@@ -8,9 +9,19 @@
 
 void Engine::run() {
 
-    initWindow(800, 600, "Window");
+	if (config.benchDescriptors) {
+		runDescriptorBench();
+		return;
+	}
+
+	if (config.headless) {
+		runHeadless();
+		return;
+	}
+
+    initWindow(config.width, config.height, "Window");
     
-    renderer = new Renderer{ ._wnd = window };
+    renderer = new Renderer{ ._wnd = window, ._frameOverlap = config.framesInFlight };
     renderer->init();
 
 	registerInputActions(window);
@@ -26,6 +37,8 @@ void Engine::run() {
 		}			
 
 		renderer->render();
+
+		if (config.maxFrames && renderer->_frameNum >= config.maxFrames) break;
     }
 
     renderer->cleanup();
@@ -34,6 +47,48 @@ void Engine::run() {
 	glfwTerminate();
 }
 
+void Engine::runHeadless() {
+
+	renderer = new Renderer{
+		._headless = true,
+		._wndExtent = { config.width, config.height },
+		._frameOverlap = config.framesInFlight,
+	};
+	renderer->init();
+
+	uint64_t frameCount = config.maxFrames ? config.maxFrames : 1000;
+
+	auto start = std::chrono::steady_clock::now();
+	while (renderer->_frameNum < frameCount) {
+		renderer->render();
+	}
+	renderer->wait_timeline(renderer->_timelineValue);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	fmt::print("headless: {} frames in {:.3f}s ({:.1f} fps)\n",
+		frameCount, elapsed.count(), frameCount / elapsed.count());
+
+	renderer->cleanup();
+	delete renderer;
+}
+
+void Engine::runDescriptorBench() {
+
+	renderer = new Renderer{
+		._headless = true,
+		._wndExtent = { config.width, config.height },
+		._frameOverlap = config.framesInFlight,
+		._enableDescriptorBuffers = true,
+	};
+	renderer->init();
+
+	vkbench::descriptors(renderer->_dev, renderer->_physDev, renderer->_allocator, renderer->_descriptorBuffers,
+		renderer->_drawImgs[0].view, 4096, 20);
+
+	renderer->cleanup();
+	delete renderer;
+}
+
 void Engine::initWindow(int width, int height, const char* title) {
 
 	glfwSetErrorCallback(glfw_error_callback);
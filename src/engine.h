@@ -9,16 +9,29 @@ static void glfw_error_callback(int error, const char* description) {
     fmt::print(stderr, "glfw error %d: %s\n", error, description);
 }
 
+struct EngineConfig {
+	bool headless = false; // render offscreen with no window, for ci and benchmarking
+	uint32_t width = 800;
+	uint32_t height = 600;
+	uint32_t framesInFlight = 2;
+	uint64_t maxFrames = 0; // 0 = run until the window is closed (headless defaults to 1000)
+	bool benchDescriptors = false; // run the descriptor microbenchmark headless and exit
+};
+
 class Engine {
 public:
 	void run();
 	
+	EngineConfig config = {};
+
 	GLFWwindow* window = nullptr;
 	GLFWmonitor* monitor = nullptr;
 	InputManager* input = nullptr;
 	Renderer* renderer = nullptr;
 
 private:
+	void runHeadless();
+	void runDescriptorBench();
 	void initWindow(int width, int height, const char* title);
 	void registerInputActions(GLFWwindow* window);
 };
\ No newline at end of file
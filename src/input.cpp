@@ -112,45 +112,44 @@ int InputManager::setActionActive(const std::string& id, bool active) {
     return 0;
 }
 
-void InputManager::processActions() {
+// check trigger for keys and mouse buttons
+static bool checkTrigger(bool current, bool previous, int event) {
+    switch (event) {
+    case GLFW_PRESS:   return current && !previous;
+    case GLFW_REPEAT:  return current && previous;
+    case GLFW_RELEASE: return !current && previous;
+    default:           return false;
+    }
+}
+
+// recurses into composites, a member rather than a std::function so checking bindings never allocates
+bool InputManager::checkBinding(const Binding& binding) const {
     double epsilon = std::numeric_limits<double>::epsilon();
 
-    // check trigger for keys and mouse buttons
-    auto checkTrigger = [](bool current, bool previous, int event) -> bool {
-        switch (event) {
-        case GLFW_PRESS:   return current && !previous;
-        case GLFW_REPEAT:  return current && previous;
-        case GLFW_RELEASE: return !current && previous;
-        default:           return false;
-        }
-    };
-
-    // recursive lambda to check binding, including composites
-    std::function<bool(const Binding&)> checkBinding;
-    checkBinding = [&](const Binding& binding) -> bool {
-        if (binding.type == Binding::Type::Composite) {
-            for (const auto& sub : binding.subBindings) 
-                if (!checkBinding(sub))
-                    return false;
-            return true;
-        }
+    if (binding.type == Binding::Type::Composite) {
+        for (const auto& sub : binding.subBindings)
+            if (!checkBinding(sub))
+                return false;
+        return true;
+    }
 
-        switch (binding.type) {
-        case Binding::Type::Key:
-            return checkTrigger(keyState[binding.code], prevKeyState[binding.code], binding.event);
-        case Binding::Type::MouseButton:
-            return checkTrigger(mbState[binding.code], prevMBState[binding.code], binding.event);
-        case Binding::Type::MouseMove:
-            return (std::abs(mouseX - prevMouseX) > epsilon) || (std::abs(mouseY - prevMouseY) > epsilon);
-        case Binding::Type::MouseScrollUp:
-            return scrollY > epsilon;
-        case Binding::Type::MouseScrollDown:
-            return scrollY < -epsilon;
-        default:
-            return false;
-        }
-    };
+    switch (binding.type) {
+    case Binding::Type::Key:
+        return checkTrigger(keyState[binding.code], prevKeyState[binding.code], binding.event);
+    case Binding::Type::MouseButton:
+        return checkTrigger(mbState[binding.code], prevMBState[binding.code], binding.event);
+    case Binding::Type::MouseMove:
+        return (std::abs(mouseX - prevMouseX) > epsilon) || (std::abs(mouseY - prevMouseY) > epsilon);
+    case Binding::Type::MouseScrollUp:
+        return scrollY > epsilon;
+    case Binding::Type::MouseScrollDown:
+        return scrollY < -epsilon;
+    default:
+        return false;
+    }
+}
 
+void InputManager::processActions() {
     // iterate over actions
     for (const auto& [actionID, action] : actions) {
         if (!action.active) continue;
@@ -90,6 +90,8 @@ public:
 
 private:
 
+    bool checkBinding(const Binding& binding) const;
+
     GLFWwindow* window;
     std::unordered_map<std::string, InputAction> actions;
 
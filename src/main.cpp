@@ -24,11 +24,86 @@
 */
 
 #include "engine.h"
-int main(int argc, char** argv) {
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <string_view>
+
+// maxImageDimension2D on most desktop gpus, the device's own limit isn't known until it's picked
+constexpr uint64_t MAX_EXTENT = 16384;
+
+static void print_usage(const char* exe) {
+    fmt::print(
+        "usage: {} [options]\n"
+        "  --headless              render offscreen with no window\n"
+        "  --width <px>            window/offscreen width, 1-16384 (default 800)\n"
+        "  --height <px>           window/offscreen height, 1-16384 (default 600)\n"
+        "  --frames-in-flight <n>  frames in flight, 1-4 (default 2)\n"
+        "  --frames <n>            exit after n frames (headless default 1000)\n"
+        "  --bench-descriptors     time the descriptor backends and exit\n"
+        "  --help                  show this message\n",
+        exe);
+}
+
+// returns false if the args are invalid or help was requested
+static bool parse_args(int argc, char** argv, EngineConfig& config) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
 
-    // TODO: parse cmd line args
+        // options that take a value
+        auto value = [&]() -> const char* { return (i + 1 < argc) ? argv[++i] : nullptr; };
+        auto uintValue = [&](uint64_t& out, uint64_t min, uint64_t max) -> bool {
+            const char* v = value();
+            if (!v) {
+                fmt::print(stderr, "error: {} expects a value\n", arg);
+                return false;
+            }
+            char* end = nullptr;
+            errno = 0;
+            out = std::strtoull(v, &end, 10);
+            // strtoull skips leading whitespace and wraps negative numbers, so the value has to start with a digit
+            if (!std::isdigit((unsigned char)*v) || *end != '\0' || errno == ERANGE || out < min || out > max) {
+                fmt::print(stderr, "error: {} expects a whole number from {} to {}, got '{}'\n", arg, min, max, v);
+                return false;
+            }
+            return true;
+        };
+
+        uint64_t n = 0;
+        if (arg == "--headless") {
+            config.headless = true;
+        } else if (arg == "--width") {
+            if (!uintValue(n, 1, MAX_EXTENT)) return false;
+            config.width = (uint32_t)n;
+        } else if (arg == "--height") {
+            if (!uintValue(n, 1, MAX_EXTENT)) return false;
+            config.height = (uint32_t)n;
+        } else if (arg == "--frames-in-flight") {
+            if (!uintValue(n, 1, 4)) return false;
+            config.framesInFlight = (uint32_t)n;
+        } else if (arg == "--frames") {
+            if (!uintValue(n, 0, UINT64_MAX)) return false;
+            config.maxFrames = n;
+        } else if (arg == "--bench-descriptors") {
+            config.benchDescriptors = true;
+        } else if (arg == "--help") {
+            return false;
+        } else {
+            fmt::print(stderr, "error: unknown option {}\n", arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
 
     Engine engine;
+    if (!parse_args(argc, argv, engine.config)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
     engine.run();
 
     return EXIT_SUCCESS;
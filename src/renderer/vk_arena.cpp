@@ -0,0 +1,121 @@
+#include "vk_arena.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    size_t round_up(size_t size, size_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void* map_pages(size_t& size, bool hugePages, bool& gotHugePages) {
+        gotHugePages = false;
+#ifdef _WIN32
+        // large pages need SeLockMemoryPrivilege, which most accounts don't have
+        size_t largePage = hugePages ? GetLargePageMinimum() : 0;
+        if (largePage) {
+            size_t largeSize = round_up(size, largePage);
+            void* ptr = VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (ptr) {
+                size = largeSize;
+                gotHugePages = true;
+                return ptr;
+            }
+        }
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        size = round_up(size, info.dwPageSize);
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+        constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+        if (hugePages) {
+            // explicit huge pages only work if the admin reserved some, otherwise ask for transparent ones
+            size_t hugeSize = round_up(size, HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+            void* ptr = mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED) {
+                size = hugeSize;
+                gotHugePages = true;
+                return ptr;
+            }
+#endif
+            size = hugeSize;
+        }
+        size = round_up(size, (size_t)sysconf(_SC_PAGESIZE));
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) return nullptr;
+#ifdef MADV_HUGEPAGE
+        if (hugePages) madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+        return ptr;
+#endif
+    }
+
+    void unmap_pages(void* ptr, size_t size) {
+#ifdef _WIN32
+        VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+        munmap(ptr, size);
+#endif
+    }
+} // namespace
+
+void LinearArena::init(size_t capacity, bool hugePages) {
+    m_reserved = capacity;
+    m_base = (uint8_t*)map_pages(m_reserved, hugePages, m_hugePages);
+    if (!m_base) {
+        fmt::print("error reserving {} byte arena\n", capacity);
+        abort();
+    }
+    m_capacity = m_reserved; // rounding up to the page size is free space
+    m_head = 0;
+    m_peak = 0;
+    m_overflow.reserve(16);
+}
+
+void LinearArena::destroy() {
+    reset();
+    if (m_base) unmap_pages(m_base, m_reserved);
+    m_base = nullptr;
+    m_capacity = 0;
+    m_reserved = 0;
+}
+
+void LinearArena::reset() {
+    rewind({ 0, 0 });
+}
+
+void LinearArena::rewind(Mark mark) {
+    m_peak = std::max(m_peak, m_head);
+    m_head = mark.head;
+    for (size_t i = mark.overflow; i < m_overflow.size(); i++) {
+        ::operator delete(m_overflow[i].ptr, std::align_val_t(m_overflow[i].alignment));
+    }
+    m_overflow.resize(std::min(mark.overflow, m_overflow.size()));
+}
+
+void* LinearArena::overflow(size_t size, size_t alignment) {
+    if (m_overflow.empty()) {
+        fmt::print("warning: {} byte arena is full, falling back to the heap until it's reset or rewound\n", m_capacity);
+    }
+    alignment = std::max(alignment, alignof(std::max_align_t));
+    void* ptr = ::operator new(round_up(size, alignment), std::align_val_t(alignment));
+    m_overflow.push_back({ ptr, alignment });
+    return ptr;
+}
+
+LinearArena& vkutil::scratch() {
+    struct Scratch {
+        LinearArena arena;
+        Scratch() { arena.init(SCRATCH_ARENA_SIZE); }
+        ~Scratch() { arena.destroy(); }
+    };
+    thread_local Scratch scratch;
+    return scratch.arena;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "vk_common.h"
+
+#include <memory_resource>
+
+// bump allocator over one block reserved up front. allocating is a pointer bump and memory is only
+// handed back all at once (reset) or back to a mark, so it's for data that lives for a frame or a scope.
+// it's also a pmr memory_resource, so std::pmr containers can allocate from it, their frees are no-ops.
+// not thread safe, give each thread its own (see vkutil::scratch)
+struct LinearArena : std::pmr::memory_resource {
+    // hugePages asks the os for large pages (2MB on x86), falling back to normal pages if it refuses
+    void init(size_t capacity, bool hugePages = false);
+    void destroy();
+
+    // alignment must be a power of 2. past the end of the block allocations fall back to the heap until
+    // they're reset or rewound, with a warning, so an undersized arena is slow rather than broken
+    void* alloc(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        size_t offset = (m_head + alignment - 1) & ~(alignment - 1);
+        if (offset + size > m_capacity) return overflow(size, alignment);
+        m_head = offset + size;
+        return m_base + offset;
+    }
+
+    // never destroyed, so only trivially destructible types
+    template <typename T, typename... Args> T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena memory is reclaimed without running destructors");
+        return new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T> std::span<T> allocArray(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena memory is reclaimed without running destructors");
+        T* data = (T*)alloc(sizeof(T) * count, alignof(T));
+        for (size_t i = 0; i < count; i++) new (data + i) T();
+        return { data, count };
+    }
+
+    // O(1), everything allocated since init or the last reset is gone
+    void reset();
+
+    // rewind() drops everything allocated after mark(), heap overflow included, for nested scopes on a shared arena
+    struct Mark {
+        size_t head;
+        size_t overflow; // overflow allocations made before the mark
+    };
+    Mark mark() const { return { m_head, m_overflow.size() }; }
+    void rewind(Mark mark);
+
+    size_t used() const { return m_head; }
+    size_t capacity() const { return m_capacity; }
+    size_t peak() const { return std::max(m_peak, m_head); }
+
+private:
+    void* do_allocate(size_t size, size_t alignment) override { return alloc(size, alignment); }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void* overflow(size_t size, size_t alignment);
+
+    uint8_t* m_base = nullptr;
+    size_t m_capacity = 0;
+    size_t m_head = 0;
+    size_t m_peak = 0;
+    size_t m_reserved = 0; // bytes actually mapped, capacity rounded up to the page size
+    bool m_hugePages = false;
+
+    struct Overflow {
+        void* ptr;
+        size_t alignment;
+    };
+    std::vector<Overflow> m_overflow;
+};
+
+// rewinds an arena to where it was on construction
+struct ArenaScope {
+    explicit ArenaScope(LinearArena& arena) : m_arena(arena), m_mark(arena.mark()) {}
+    ~ArenaScope() { m_arena.rewind(m_mark); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    LinearArena& m_arena;
+    LinearArena::Mark m_mark;
+};
+
+constexpr size_t SCRATCH_ARENA_SIZE = 1024 * 1024;
+
+namespace vkutil {
+    // this thread's scratch arena, created on first use. only allocate from it inside an ArenaScope,
+    // so whatever a function leaves behind is gone when it returns
+    LinearArena& scratch();
+}
@@ -0,0 +1,185 @@
+#include "vk_autotune.h"
+#include "vk_initialisers.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    // x*y stays a multiple of 64, so a group is whole waves on every vendor (32 and 64 wide)
+    constexpr VkExtent2D CANDIDATES[] = {
+        { 8, 8 }, { 16, 4 }, { 4, 16 }, { 32, 2 }, { 64, 1 },
+        { 16, 8 }, { 8, 16 }, { 32, 4 },
+        { 16, 16 }, { 32, 8 }, { 8, 32 }, { 64, 4 },
+        { 32, 16 }, { 16, 32 },
+        { 32, 32 },
+    };
+    constexpr uint32_t TUNE_DISPATCHES = 8;
+    constexpr uint32_t TUNE_RUNS = 3;
+} // namespace
+
+void WorkgroupTuner::init(VkDevice device, VkPhysicalDevice physDev, uint32_t queueFamily, VkQueue queue, const char* path) {
+    m_path = path;
+    m_queue = queue;
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physDev, &props);
+    m_limits = props.limits;
+    m_periodNs = props.limits.timestampPeriod;
+    m_deviceKey = fmt::format("{:04x}:{:04x}:{:08x}", props.vendorID, props.deviceID, props.driverVersion);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physDev, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physDev, &familyCount, families.data());
+
+    // 0 valid bits means the queue can't write timestamps, and nothing gets tuned
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    m_validMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+    // one line per kernel per device: <vendor:device:driver> <name> <x> <y>
+    std::ifstream file(m_path);
+    std::string key, name;
+    VkExtent2D size;
+    while (file >> key >> name >> size.width >> size.height) {
+        m_results[key + " " + name] = size;
+    }
+
+    if (!validBits) return;
+
+    auto poolInfo = vkinit::cmd_pool_create_info(queueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &m_pool));
+    auto allocInfo = vkinit::cmd_buffer_alloc_info(m_pool);
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &m_cmd));
+    auto fenceInfo = vkinit::fence_create_info();
+    VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &m_fence));
+    auto queryInfo = vkinit::query_pool_create_info(VK_QUERY_TYPE_TIMESTAMP, 2);
+    VK_CHECK(vkCreateQueryPool(device, &queryInfo, nullptr, &m_queries));
+}
+
+void WorkgroupTuner::destroy(VkDevice device) {
+    vkDestroyQueryPool(device, m_queries, nullptr);
+    vkDestroyFence(device, m_fence, nullptr);
+    vkDestroyCommandPool(device, m_pool, nullptr);
+    m_queries = VK_NULL_HANDLE;
+    m_fence = VK_NULL_HANDLE;
+    m_pool = VK_NULL_HANDLE;
+    m_cmd = VK_NULL_HANDLE;
+}
+
+void WorkgroupTuner::save() {
+    if (!m_dirty) return;
+
+    std::string tmpPath = m_path + ".tmp";
+    std::ofstream file(tmpPath, std::ios::trunc);
+    if (!file.is_open()) {
+        fmt::print("error writing tuning results {}\n", tmpPath);
+        return;
+    }
+    for (auto& [key, size] : m_results) file << key << ' ' << size.width << ' ' << size.height << '\n';
+    file.close();
+    if (!file) {
+        fmt::print("error writing tuning results {}\n", tmpPath);
+        return;
+    }
+
+    std::error_code err;
+    std::filesystem::rename(tmpPath, m_path, err);
+    if (err) fmt::print("error replacing tuning results {}: {}\n", m_path, err.message());
+    else m_dirty = false;
+}
+
+VkExtent2D WorkgroupTuner::tune(VkDevice device, PipelineRegistry& registry, const char* name, const ComputePipelineBuilder& builder,
+    const ShaderReflection& reflection, const std::function<void(VkCommandBuffer cmd)>& setup,
+    const std::function<void(VkCommandBuffer cmd, VkPipeline pipeline, VkExtent2D groupSize)>& dispatch) {
+    VkExtent2D compiled = { reflection.localSize[0], reflection.localSize[1] };
+    uint32_t specX = reflection.localSizeSpecIds[0];
+    uint32_t specY = reflection.localSizeSpecIds[1];
+    if (specX == UINT32_MAX || specY == UINT32_MAX) return compiled;
+
+    auto fits = [&](VkExtent2D size) {
+        return size.width <= m_limits.maxComputeWorkGroupSize[0] && size.height <= m_limits.maxComputeWorkGroupSize[1]
+            && size.width * size.height <= m_limits.maxComputeWorkGroupInvocations;
+    };
+
+    std::string key = m_deviceKey + " " + name;
+    auto it = m_results.find(key);
+    if (it != m_results.end() && fits(it->second)) return it->second;
+    if (!m_pool) return compiled;
+
+    fmt::print("tuning {} workgroup size\n", name);
+    VkExtent2D best = compiled;
+    double bestNs = std::numeric_limits<double>::max();
+    for (auto size : CANDIDATES) {
+        if (!fits(size)) continue;
+
+        auto candidate = builder;
+        candidate.setSpecialization(specX, size.width).setSpecialization(specY, size.height);
+        bool cached = false;
+        VkPipeline pipeline = registry.get(device, candidate, &cached);
+
+        // measure waits for the gpu, so candidates built just for this are dropped straight after. the
+        // winner goes too, the caller builds its final pipelines with the size set alongside its other state
+        double ns = measure(device, pipeline, size, setup, dispatch);
+        if (!cached) registry.release(device, candidate);
+        fmt::print("  {:>2}x{:<2} {:8.1f} us\n", size.width, size.height, ns / 1000.0);
+        if (ns < bestNs) {
+            bestNs = ns;
+            best = size;
+        }
+    }
+    fmt::print("  picked {}x{}\n", best.width, best.height);
+
+    m_results[key] = best;
+    m_dirty = true;
+    return best;
+}
+
+double WorkgroupTuner::measure(VkDevice device, VkPipeline pipeline, VkExtent2D groupSize, const std::function<void(VkCommandBuffer cmd)>& setup,
+    const std::function<void(VkCommandBuffer cmd, VkPipeline pipeline, VkExtent2D groupSize)>& dispatch) {
+    // each dispatch writes what the last one did, keep them in order so they aren't timed overlapping
+    VkMemoryBarrier2 barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT;
+    VkDependencyInfo dependency = {};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.memoryBarrierCount = 1;
+    dependency.pMemoryBarriers = &barrier;
+
+    double best = std::numeric_limits<double>::max();
+    for (uint32_t run = 0; run < TUNE_RUNS; run++) {
+        VK_CHECK(vkResetCommandBuffer(m_cmd, 0));
+        auto beginInfo = vkinit::cmd_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VK_CHECK(vkBeginCommandBuffer(m_cmd, &beginInfo));
+
+        vkCmdResetQueryPool(m_cmd, m_queries, 0, 2);
+        setup(m_cmd);
+
+        // first dispatch warms caches and clocks, and isn't timed
+        dispatch(m_cmd, pipeline, groupSize);
+        vkCmdPipelineBarrier2(m_cmd, &dependency);
+        vkCmdWriteTimestamp2(m_cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, m_queries, 0);
+        for (uint32_t i = 0; i < TUNE_DISPATCHES; i++) {
+            dispatch(m_cmd, pipeline, groupSize);
+            vkCmdPipelineBarrier2(m_cmd, &dependency);
+        }
+        vkCmdWriteTimestamp2(m_cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, m_queries, 1);
+
+        VK_CHECK(vkEndCommandBuffer(m_cmd));
+
+        auto cmdInfo = vkinit::cmd_buffer_submit_info(m_cmd);
+        auto submit = vkinit::submit_info(&cmdInfo, nullptr, nullptr, 0, 0);
+        VK_CHECK(vkQueueSubmit2(m_queue, 1, &submit, m_fence));
+        VK_CHECK(vkWaitForFences(device, 1, &m_fence, true, UINT64_MAX));
+        VK_CHECK(vkResetFences(device, 1, &m_fence));
+
+        uint64_t timestamps[2];
+        VK_CHECK(vkGetQueryPoolResults(device, m_queries, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & m_validMask;
+        best = std::min(best, (double)ticks * m_periodNs / TUNE_DISPATCHES);
+    }
+    return best;
+}
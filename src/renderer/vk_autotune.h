@@ -0,0 +1,41 @@
+#pragma once
+#include "vk_common.h"
+#include "vk_pipelines.h"
+
+#include <map>
+
+// picks a compute shader's workgroup size by timing its spec constant permutations on the gpu the first
+// time it's seen. the winners are saved keyed by device and driver, so later runs skip the benchmark
+struct WorkgroupTuner {
+    void init(VkDevice device, VkPhysicalDevice physDev, uint32_t queueFamily, VkQueue queue, const char* path);
+    void destroy(VkDevice device);
+
+    // writes the file if anything new was tuned
+    void save();
+
+    // setup is recorded once per run (layout transitions), dispatch records one full run of the kernel.
+    // if the shader's x/y size isn't spec constants, or timestamps aren't supported, returns its compiled size.
+    // candidates the registry didn't already have are destroyed once measured
+    VkExtent2D tune(VkDevice device, PipelineRegistry& registry, const char* name, const ComputePipelineBuilder& builder,
+        const ShaderReflection& reflection, const std::function<void(VkCommandBuffer cmd)>& setup,
+        const std::function<void(VkCommandBuffer cmd, VkPipeline pipeline, VkExtent2D groupSize)>& dispatch);
+
+private:
+    // best of a few submits, in ns per dispatch
+    double measure(VkDevice device, VkPipeline pipeline, VkExtent2D groupSize, const std::function<void(VkCommandBuffer cmd)>& setup,
+        const std::function<void(VkCommandBuffer cmd, VkPipeline pipeline, VkExtent2D groupSize)>& dispatch);
+
+    std::string m_path;
+    std::string m_deviceKey; // vendor:device:driver
+    std::map<std::string, VkExtent2D> m_results; // "deviceKey name", every device in the file
+    bool m_dirty = false;
+
+    VkPhysicalDeviceLimits m_limits = {};
+    VkQueue m_queue = VK_NULL_HANDLE;
+    VkCommandPool m_pool = VK_NULL_HANDLE;
+    VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+    VkFence m_fence = VK_NULL_HANDLE;
+    VkQueryPool m_queries = VK_NULL_HANDLE;
+    float m_periodNs = 0.0f;
+    uint64_t m_validMask = 0;
+};
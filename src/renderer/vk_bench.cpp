@@ -0,0 +1,48 @@
+#include "vk_bench.h"
+#include "vk_buffers.h"
+#include "vk_descriptors.h"
+
+#include <chrono>
+
+void vkbench::descriptors(VkDevice device, VkPhysicalDevice physDev, VmaAllocator allocator, bool descriptorBuffers,
+    VkImageView view, uint32_t setCount, uint32_t iterations) {
+    VkDeviceSize bufferSize = 64 * 1024;
+    AllocatedBuffer buffer = vkutil::create_buffer(allocator, bufferSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+
+    auto run = [&](bool useDescriptorBuffer) {
+        TransientDescriptors descriptors = {};
+        descriptors.init(device, physDev, allocator, useDescriptorBuffer);
+
+        DescriptorLayoutBuilder builder = {};
+        builder.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        builder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        VkDescriptorSetLayout layout = builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT, nullptr, descriptors.layoutFlags());
+
+        // first iteration grows the pools, best of the rest is the steady state cost
+        double best = std::numeric_limits<double>::max();
+        for (uint32_t i = 0; i < iterations + 1; i++) {
+            descriptors.clear(device);
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t s = 0; s < setCount; s++) {
+                auto set = descriptors.allocate(device, layout);
+                descriptors.writeImage(device, layout, set, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, view, VK_IMAGE_LAYOUT_GENERAL);
+                descriptors.writeBuffer(device, layout, set, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer.buffer, 0, bufferSize);
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            if (i > 0) best = std::min(best, elapsed.count() / setCount);
+        }
+
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        descriptors.destroy(device, allocator);
+        return best;
+    };
+
+    fmt::print("descriptors: {} sets x {} iterations\n", setCount, iterations);
+    fmt::print("  pool path:              {:.1f} ns/set\n", run(false));
+    if (descriptorBuffers) fmt::print("  descriptor buffer path: {:.1f} ns/set\n", run(true));
+    else fmt::print("  descriptor buffer path: VK_EXT_descriptor_buffer not supported\n");
+
+    vkutil::destroy_buffer(allocator, buffer);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "vk_common.h"
+
+// cpu side microbenchmarks, run from the command line (see main.cpp)
+namespace vkbench {
+    // allocates and writes setCount transient sets (a storage img and a storage buffer each) per iteration,
+    // through the pool path and, when the device has it enabled, the descriptor buffer path. prints the best ns/set
+    void descriptors(VkDevice device, VkPhysicalDevice physDev, VmaAllocator allocator, bool descriptorBuffers,
+        VkImageView view, uint32_t setCount, uint32_t iterations);
+}
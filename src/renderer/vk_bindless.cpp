@@ -0,0 +1,135 @@
+#include "vk_bindless.h"
+#include "vk_descriptors.h"
+
+namespace {
+    VkDescriptorType descriptor_type(BindlessType type) {
+        switch (type) {
+        case BindlessType::SampledImage: return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        case BindlessType::StorageImage: return VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        case BindlessType::Sampler: return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case BindlessType::StorageBuffer: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        default: return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+        }
+    }
+} // namespace
+
+void BindlessHeap::init(VkDevice device, VkPhysicalDevice physDev) {
+    // clamp the arrays to what the device allows for update after bind sets
+    VkPhysicalDeviceVulkan12Properties props12 = {};
+    props12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 props = {};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &props12;
+    vkGetPhysicalDeviceProperties2(physDev, &props);
+
+    m_slots[(uint32_t)BindlessType::SampledImage].capacity = std::min({ BINDLESS_MAX_SAMPLED_IMAGES,
+        props12.maxDescriptorSetUpdateAfterBindSampledImages, props12.maxPerStageDescriptorUpdateAfterBindSampledImages });
+    m_slots[(uint32_t)BindlessType::StorageImage].capacity = std::min({ BINDLESS_MAX_STORAGE_IMAGES,
+        props12.maxDescriptorSetUpdateAfterBindStorageImages, props12.maxPerStageDescriptorUpdateAfterBindStorageImages });
+    m_slots[(uint32_t)BindlessType::Sampler].capacity = std::min({ BINDLESS_MAX_SAMPLERS,
+        props12.maxDescriptorSetUpdateAfterBindSamplers, props12.maxPerStageDescriptorUpdateAfterBindSamplers });
+    m_slots[(uint32_t)BindlessType::StorageBuffer].capacity = std::min({ BINDLESS_MAX_STORAGE_BUFFERS,
+        props12.maxDescriptorSetUpdateAfterBindStorageBuffers, props12.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+
+    DescriptorLayoutBuilder builder = {};
+    VkDescriptorBindingFlags bindingFlags[(uint32_t)BindlessType::Count];
+    VkDescriptorPoolSize poolSizes[(uint32_t)BindlessType::Count];
+    for (uint32_t i = 0; i < (uint32_t)BindlessType::Count; i++) {
+        auto type = descriptor_type((BindlessType)i);
+        builder.addBinding(i, type, m_slots[i].capacity);
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+        poolSizes[i] = { type, m_slots[i].capacity };
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flagsInfo.bindingCount = (uint32_t)BindlessType::Count;
+    flagsInfo.pBindingFlags = bindingFlags;
+    m_layout = builder.build(device, VK_SHADER_STAGE_ALL, &flagsInfo, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = (uint32_t)BindlessType::Count;
+    poolInfo.pPoolSizes = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_pool));
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_layout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &m_set));
+}
+
+void BindlessHeap::destroy(VkDevice device) {
+    vkDestroyDescriptorPool(device, m_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_layout, nullptr);
+    for (auto& slots : m_slots) slots = {};
+}
+
+uint32_t BindlessHeap::addSampledImage(VkDevice device, VkImageView view, VkImageLayout layout) {
+    uint32_t index = allocSlot(BindlessType::SampledImage);
+    VkDescriptorImageInfo info = { VK_NULL_HANDLE, view, layout };
+    write(device, BindlessType::SampledImage, index, &info, nullptr);
+    return index;
+}
+
+uint32_t BindlessHeap::addStorageImage(VkDevice device, VkImageView view) {
+    uint32_t index = allocSlot(BindlessType::StorageImage);
+    VkDescriptorImageInfo info = { VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL };
+    write(device, BindlessType::StorageImage, index, &info, nullptr);
+    return index;
+}
+
+uint32_t BindlessHeap::addSampler(VkDevice device, VkSampler sampler) {
+    uint32_t index = allocSlot(BindlessType::Sampler);
+    VkDescriptorImageInfo info = { sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+    write(device, BindlessType::Sampler, index, &info, nullptr);
+    return index;
+}
+
+uint32_t BindlessHeap::addStorageBuffer(VkDevice device, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    uint32_t index = allocSlot(BindlessType::StorageBuffer);
+    VkDescriptorBufferInfo info = { buffer, offset, range };
+    write(device, BindlessType::StorageBuffer, index, nullptr, &info);
+    return index;
+}
+
+void BindlessHeap::remove(BindlessType type, uint32_t index) {
+    if (index == BINDLESS_INVALID) return;
+    m_slots[(uint32_t)type].free.push_back(index);
+}
+
+void BindlessHeap::bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) {
+    vkCmdBindDescriptorSets(cmd, bindPoint, layout, 0, 1, &m_set, 0, nullptr);
+}
+
+uint32_t BindlessHeap::allocSlot(BindlessType type) {
+    auto& slots = m_slots[(uint32_t)type];
+    if (!slots.free.empty()) {
+        uint32_t index = slots.free.back();
+        slots.free.pop_back();
+        return index;
+    }
+    if (slots.next == slots.capacity) {
+        fmt::print("bindless heap out of slots for binding {}\n", (uint32_t)type);
+        abort();
+    }
+    return slots.next++;
+}
+
+void BindlessHeap::write(VkDevice device, BindlessType type, uint32_t index, const VkDescriptorImageInfo* imgInfo, const VkDescriptorBufferInfo* bufferInfo) {
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.pNext = nullptr;
+    write.dstSet = m_set;
+    write.dstBinding = (uint32_t)type;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = descriptor_type(type);
+    write.pImageInfo = imgInfo;
+    write.pBufferInfo = bufferInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "vk_common.h"
+
+// bindings of the global set, shaders/bindless.hlsli has to match
+enum class BindlessType : uint32_t {
+    SampledImage = 0,
+    StorageImage = 1,
+    Sampler = 2,
+    StorageBuffer = 3,
+    Count
+};
+
+constexpr uint32_t BINDLESS_MAX_SAMPLED_IMAGES = 16384;
+constexpr uint32_t BINDLESS_MAX_STORAGE_IMAGES = 4096;
+constexpr uint32_t BINDLESS_MAX_SAMPLERS = 256;
+constexpr uint32_t BINDLESS_MAX_STORAGE_BUFFERS = 16384;
+
+constexpr uint32_t BINDLESS_INVALID = UINT32_MAX;
+
+// one update after bind, partially bound set holding every resource the shaders can reach.
+// resources get a stable index into their type's array, which is pushed to the shader instead of
+// binding a set per draw. the set is bound once per cmd buffer and written while frames are in flight,
+// so an index must not be removed until the last submit using it has retired
+struct BindlessHeap {
+    void init(VkDevice device, VkPhysicalDevice physDev);
+    void destroy(VkDevice device);
+
+    uint32_t addSampledImage(VkDevice device, VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t addStorageImage(VkDevice device, VkImageView view);
+    uint32_t addSampler(VkDevice device, VkSampler sampler);
+    uint32_t addStorageBuffer(VkDevice device, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // hands the index back for reuse, the descriptor itself is left as is (partially bound)
+    void remove(BindlessType type, uint32_t index);
+
+    // binds the set to set 0 of layout
+    void bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+
+    VkDescriptorSetLayout layout() const { return m_layout; }
+    VkDescriptorSet set() const { return m_set; }
+
+private:
+    struct Slots {
+        uint32_t capacity = 0;
+        uint32_t next = 0; // first never used index
+        std::vector<uint32_t> free;
+    };
+
+    uint32_t allocSlot(BindlessType type);
+    void write(VkDevice device, BindlessType type, uint32_t index, const VkDescriptorImageInfo* imgInfo, const VkDescriptorBufferInfo* bufferInfo);
+
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+    VkDescriptorSet m_set = VK_NULL_HANDLE;
+    Slots m_slots[(uint32_t)BindlessType::Count];
+};
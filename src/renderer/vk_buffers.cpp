@@ -0,0 +1,163 @@
+#include "vk_buffers.h"
+
+#include <cstring>
+
+AllocatedBuffer vkutil::create_buffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+    VmaAllocationCreateFlags allocationFlags, VkMemoryPropertyFlags requiredFlags, MemoryCategory category) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocInfo.flags = allocationFlags;
+    allocInfo.requiredFlags = requiredFlags;
+
+    AllocatedBuffer buffer = {};
+    VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer.buffer, &buffer.allocation, &buffer.info));
+    track_allocation(allocator, buffer.allocation, category);
+    return buffer;
+}
+
+void vkutil::destroy_buffer(VmaAllocator allocator, const AllocatedBuffer& buffer) {
+    untrack_allocation(allocator, buffer.allocation);
+    vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+}
+
+void FrameRingBuffer::init(VmaAllocator allocator, VkDeviceSize frameSize, uint32_t frameCount, VkDeviceSize minAlignment) {
+    m_frameSize = frameSize;
+    m_minAlignment = std::max<VkDeviceSize>(minAlignment, 16);
+
+    // one buffer serves uniforms, vertex/index data and staging copies alike
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    m_buffer = vkutil::create_buffer(allocator, frameSize * frameCount, usage,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::FrameData);
+
+    beginFrame(0);
+}
+
+void FrameRingBuffer::destroy(VmaAllocator allocator) {
+    vkutil::destroy_buffer(allocator, m_buffer);
+    m_buffer = {};
+}
+
+void FrameRingBuffer::beginFrame(uint32_t frameIndex) {
+    m_frameBegin = frameIndex * m_frameSize;
+    m_frameEnd = m_frameBegin + m_frameSize;
+    m_head.store(m_frameBegin, std::memory_order_relaxed);
+}
+
+FrameRingBuffer::Alloc FrameRingBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    alignment = std::max(alignment, m_minAlignment);
+
+    VkDeviceSize head = m_head.load(std::memory_order_relaxed);
+    VkDeviceSize offset;
+    do {
+        offset = (head + alignment - 1) & ~(alignment - 1);
+        if (offset + size > m_frameEnd) return {};
+    } while (!m_head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+    return { m_buffer.buffer, offset, (char*)m_buffer.info.pMappedData + offset };
+}
+
+FrameRingBuffer::Alloc FrameRingBuffer::push(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+    auto alloc = allocate(size, alignment);
+    if (alloc.ptr) memcpy(alloc.ptr, data, size);
+    return alloc;
+}
+
+void BufferSuballocator::init(VkDevice device, VkPhysicalDevice physDev, VmaAllocator allocator, VkDeviceSize blockSize) {
+    m_device = device;
+    m_allocator = allocator;
+    m_blockSize = blockSize;
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physDev, &props);
+    m_minAlignment = std::max({ props.limits.minUniformBufferOffsetAlignment, props.limits.minStorageBufferOffsetAlignment, (VkDeviceSize)16 });
+}
+
+void BufferSuballocator::destroy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& block : m_blocks) {
+        // anything still allocated goes with the block
+        vmaClearVirtualBlock(block.virtualBlock);
+        vmaDestroyVirtualBlock(block.virtualBlock);
+        vkutil::destroy_buffer(m_allocator, block.buffer);
+    }
+    m_blocks.clear();
+}
+
+BufferRange BufferSuballocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    VmaVirtualAllocationCreateInfo info = {};
+    info.size = size;
+    info.alignment = std::max(alignment, m_minAlignment);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // newest block first, it's the one most likely to have room
+    BufferRange range = {};
+    range.size = size;
+    bool found = false;
+    for (size_t i = m_blocks.size(); i-- > 0 && !found;) {
+        if (vmaVirtualAllocate(m_blocks[i].virtualBlock, &info, &range.allocation, &range.offset) == VK_SUCCESS) {
+            range.block = (uint32_t)i;
+            found = true;
+        }
+    }
+    if (!found) {
+        createBlock(std::max(m_blockSize, size));
+        range.block = (uint32_t)(m_blocks.size() - 1);
+        VK_CHECK(vmaVirtualAllocate(m_blocks.back().virtualBlock, &info, &range.allocation, &range.offset));
+    }
+
+    auto& block = m_blocks[range.block];
+    range.buffer = block.buffer.buffer;
+    range.address = block.address + range.offset;
+    return range;
+}
+
+void BufferSuballocator::free(const BufferRange& range) {
+    if (!range.allocation) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    vmaVirtualFree(m_blocks[range.block].virtualBlock, range.allocation);
+}
+
+BufferSuballocator::Stats BufferSuballocator::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = {};
+    stats.blocks = (uint32_t)m_blocks.size();
+    for (auto& block : m_blocks) {
+        VmaStatistics blockStats;
+        vmaGetVirtualBlockStatistics(block.virtualBlock, &blockStats);
+        stats.ranges += blockStats.allocationCount;
+        stats.used += blockStats.allocationBytes;
+        stats.reserved += blockStats.blockBytes;
+    }
+    return stats;
+}
+
+void BufferSuballocator::createBlock(VkDeviceSize size) {
+    Block block = {};
+    block.buffer = vkutil::create_buffer(m_allocator, size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VmaVirtualBlockCreateInfo blockInfo = {};
+    blockInfo.size = size;
+    VK_CHECK(vmaCreateVirtualBlock(&blockInfo, &block.virtualBlock));
+
+    VkBufferDeviceAddressInfo addressInfo = {};
+    addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    addressInfo.pNext = nullptr;
+    addressInfo.buffer = block.buffer.buffer;
+    block.address = vkGetBufferDeviceAddress(m_device, &addressInfo);
+
+    m_blocks.push_back(block);
+}
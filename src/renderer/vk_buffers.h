@@ -0,0 +1,98 @@
+#pragma once
+#include "vk_common.h"
+#include "vk_memory.h"
+
+#include <mutex>
+
+namespace vkutil {
+    // allocationFlags are VMA_ALLOCATION_CREATE_* flags, pass HOST_ACCESS_* | MAPPED for a persistently mapped buffer
+    AllocatedBuffer create_buffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+        VmaAllocationCreateFlags allocationFlags = 0, VkMemoryPropertyFlags requiredFlags = 0, MemoryCategory category = MemoryCategory::Buffers);
+    void destroy_buffer(VmaAllocator allocator, const AllocatedBuffer& buffer);
+}
+
+// one persistently mapped, host coherent buffer split into a region per frame in flight.
+// allocations bump a per frame offset and are never freed individually, the whole region
+// is handed back by beginFrame once the frame's last submit has retired
+struct FrameRingBuffer {
+    struct Alloc {
+        VkBuffer buffer = VK_NULL_HANDLE; // null when the frame's region is full
+        VkDeviceSize offset = 0; // from the start of buffer
+        void* ptr = nullptr;
+    };
+
+    void init(VmaAllocator allocator, VkDeviceSize frameSize, uint32_t frameCount, VkDeviceSize minAlignment);
+    void destroy(VmaAllocator allocator);
+
+    // call once the frame's timeline value has been waited on
+    void beginFrame(uint32_t frameIndex);
+
+    // lock free, safe to call from any thread while recording the current frame. alignment must be a power of 2
+    Alloc allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+    // copies data in and returns where it landed
+    Alloc push(const void* data, VkDeviceSize size, VkDeviceSize alignment = 0);
+
+    VkBuffer buffer() const { return m_buffer.buffer; }
+    VkDeviceSize used() const { return m_head.load(std::memory_order_relaxed) - m_frameBegin; }
+
+private:
+    AllocatedBuffer m_buffer = {};
+    VkDeviceSize m_frameSize = 0;
+    VkDeviceSize m_minAlignment = 1;
+
+    VkDeviceSize m_frameBegin = 0, m_frameEnd = 0;
+    std::atomic<VkDeviceSize> m_head = 0;
+};
+
+constexpr VkDeviceSize BUFFER_BLOCK_SIZE = 64 * 1024 * 1024;
+
+// a range carved out of one of a BufferSuballocator's blocks
+struct BufferRange {
+    VkBuffer buffer = VK_NULL_HANDLE; // the block's buffer, shared with every other range in it
+    VkDeviceSize offset = 0; // from the start of buffer
+    VkDeviceSize size = 0;
+    VkDeviceAddress address = 0; // of the range's first byte
+    VmaVirtualAllocation allocation = VK_NULL_HANDLE;
+    uint32_t block = 0;
+};
+
+// device local vertex, index, uniform and storage ranges sub-allocated out of a few large buffers through
+// VMA virtual blocks, so thousands of small buffers cost a handful of vulkan allocations rather than running
+// into maxMemoryAllocationCount (4096 on some drivers). blocks are created on demand and kept until destroy
+struct BufferSuballocator {
+    struct Stats {
+        uint32_t blocks = 0;
+        uint32_t ranges = 0;
+        VkDeviceSize reserved = 0; // bytes of device memory held by the blocks
+        VkDeviceSize used = 0; // bytes handed out as ranges
+    };
+
+    void init(VkDevice device, VkPhysicalDevice physDev, VmaAllocator allocator, VkDeviceSize blockSize = BUFFER_BLOCK_SIZE);
+    void destroy();
+
+    // thread safe. alignment must be a power of 2, 0 uses the device's uniform/storage offset alignment.
+    // a range bigger than the block size gets a block of its own
+    BufferRange allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+    // the range must no longer be in use by the gpu, retire it through the RetireQueue while it might be
+    void free(const BufferRange& range);
+
+    Stats stats() const;
+
+private:
+    struct Block {
+        AllocatedBuffer buffer;
+        VmaVirtualBlock virtualBlock;
+        VkDeviceAddress address;
+    };
+
+    void createBlock(VkDeviceSize size);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    VkDeviceSize m_blockSize = 0;
+    VkDeviceSize m_minAlignment = 16;
+
+    mutable std::mutex m_mutex;
+    std::vector<Block> m_blocks; // never shrinks, so BufferRange::block stays valid
+};
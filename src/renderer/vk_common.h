@@ -12,6 +12,7 @@
 #include <fmt/core.h>
 
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
 
 #include <memory>
@@ -25,6 +26,8 @@
 #include <set>
 #include <limits>
 #include <algorithm>
+#include <atomic>
+#include <type_traits>
 
 #ifdef _DEBUG
 #define VULKAN_DEBUG_REPORT
@@ -40,10 +43,45 @@
     } while (0)
 // VK_CHECK
 
+namespace vkutil {
+    // maxPushConstantsSize every device supports, a bigger block needs checking against the limit
+    constexpr uint32_t PUSH_CONSTANT_MIN_SIZE = 128;
+
+    // T is copied as is, so its layout has to match the shader's block: 4 byte scalars and vectors, no padding
+    template <typename T> void push_constants(VkCommandBuffer cmd, VkPipelineLayout layout, VkShaderStageFlags stages, const T& data, uint32_t offset = 0) {
+        static_assert(std::is_trivially_copyable_v<T>, "push constants are copied bytewise");
+        static_assert(sizeof(T) % 4 == 0, "push constant ranges are a multiple of 4 bytes");
+        static_assert(sizeof(T) <= PUSH_CONSTANT_MIN_SIZE, "bigger than the 128 bytes every device supports");
+        vkCmdPushConstants(cmd, layout, stages, offset, sizeof(T), &data);
+    }
+
+    constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+    // fnv-1a, only feed it plain structs without pointers or padding
+    inline uint64_t hash_bytes(uint64_t h, const void* data, size_t size) {
+        auto bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++) {
+            h ^= bytes[i];
+            h *= 0x100000001b3ull;
+        }
+        return h;
+    }
+
+    template <typename T> uint64_t hash_value(uint64_t h, const T& value) {
+        return hash_bytes(h, &value, sizeof(T));
+    }
+} // namespace vkutil
+
 struct AllocatedImg {
     VkImage img;
     VkImageView view;
     VmaAllocation allocation;
     VkExtent3D extent;
     VkFormat format;
+};
+
+struct AllocatedBuffer {
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    VmaAllocationInfo info; // info.pMappedData is set for mapped buffers
 };
\ No newline at end of file
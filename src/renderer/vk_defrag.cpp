@@ -0,0 +1,374 @@
+#include "vk_defrag.h"
+#include "vk_arena.h"
+#include "vk_initialisers.h"
+
+#include <chrono>
+
+namespace {
+    constexpr float MB = 1024.0f * 1024.0f;
+
+    VkImageAspectFlags aspect_flags(VkFormat format) {
+        switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    VkImageSubresourceRange full_range(const VkImageCreateInfo& info) {
+        VkImageSubresourceRange range = {};
+        range.aspectMask = aspect_flags(info.format);
+        range.levelCount = info.mipLevels;
+        range.layerCount = info.arrayLayers;
+        return range;
+    }
+
+    VkImageViewType view_type(const VkImageCreateInfo& info) {
+        if (info.imageType == VK_IMAGE_TYPE_3D) return VK_IMAGE_VIEW_TYPE_3D;
+        if (info.flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) return info.arrayLayers > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+        if (info.imageType == VK_IMAGE_TYPE_1D) return info.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D;
+        return info.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    }
+} // namespace
+
+void Defragmenter::init(VkDevice device, VmaAllocator allocator, VkSemaphore timeline, BindlessHeap* bindless, UploadService* uploads) {
+    m_device = device;
+    m_allocator = allocator;
+    m_timeline = timeline;
+    m_bindless = bindless;
+    m_uploads = uploads;
+}
+
+void Defragmenter::destroy() {
+    if (m_passPending) endPass();
+    if (running()) end();
+    m_resources.clear();
+    m_freeIds.clear();
+    m_byAllocation.clear();
+}
+
+DefragId Defragmenter::add(const Resource& res, VmaAllocation allocation) {
+    DefragId id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+        m_resources[id] = res;
+    } else {
+        id = (DefragId)m_resources.size();
+        m_resources.push_back(res);
+    }
+    m_byAllocation[allocation] = id;
+    return id;
+}
+
+DefragId Defragmenter::registerImage(const AllocatedImg& img, const VkImageCreateInfo& info, VkImageLayout layout,
+    BindlessType bindless, uint32_t bindlessIndex) {
+    // the recreated img has to fit the old one's memory requirements, so the info is reused as is
+    auto copyUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if ((info.usage & copyUsage) != copyUsage || info.sharingMode != VK_SHARING_MODE_EXCLUSIVE) {
+        fmt::print("defragmenter: registered imgs need transfer src and dst usage, and exclusive sharing\n");
+        abort();
+    }
+
+    Resource res = {};
+    res.img = img;
+    res.imgInfo = info;
+    res.imgInfo.pNext = nullptr; // the caller's chain doesn't outlive the call
+    res.imgInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    res.layout = layout;
+    res.bindlessType = bindless;
+    res.bindlessIndex = bindlessIndex;
+    return add(res, img.allocation);
+}
+
+DefragId Defragmenter::registerBuffer(const AllocatedBuffer& buffer, const VkBufferCreateInfo& info,
+    BindlessType bindless, uint32_t bindlessIndex) {
+    if (info.usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+        fmt::print("defragmenter: buffers reached by device address can't be moved\n");
+        abort();
+    }
+    auto copyUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if ((info.usage & copyUsage) != copyUsage || info.sharingMode != VK_SHARING_MODE_EXCLUSIVE) {
+        fmt::print("defragmenter: registered buffers need transfer src and dst usage, and exclusive sharing\n");
+        abort();
+    }
+
+    Resource res = {};
+    res.buffer = buffer;
+    res.bufferInfo = info;
+    res.bufferInfo.pNext = nullptr;
+    res.bindlessType = bindless;
+    res.bindlessIndex = bindlessIndex;
+    return add(res, buffer.allocation);
+}
+
+void Defragmenter::unregister(DefragId id) {
+    auto& res = m_resources[id];
+    if (res.moving) {
+        if (m_passUnsubmitted) {
+            fmt::print("defragmenter: unregister of a moving resource before its frame was submitted would never return\n");
+            abort();
+        }
+        // vma can't free an allocation mid move, so see the pass through first. at most a frame's wait
+        auto waitInfo = vkinit::semaphore_wait_info(&m_timeline, &m_passValue);
+        VK_CHECK(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX));
+        m_uploads->wait(m_device, m_passToken);
+        endPass();
+    }
+
+    m_byAllocation.erase(res.img.img ? res.img.allocation : res.buffer.allocation);
+    res = {};
+    m_freeIds.push_back(id);
+}
+
+void Defragmenter::update(uint64_t frameNum, const MemoryBudget& memory) {
+    m_passUnsubmitted = false;
+    if (m_passPending) {
+        uint64_t completed = 0;
+        VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline, &completed));
+        if (completed >= m_passValue && m_uploads->isComplete(m_device, m_passToken)) endPass();
+    }
+
+    if (!m_automatic || running() || m_byAllocation.empty() || frameNum % DEFRAG_CHECK_INTERVAL != 0) return;
+
+    // blockBytes - allocationBytes is what vma holds but hasn't handed out, cheap as the budgets are already polled
+    m_waste = 0;
+    for (uint32_t heap = 0; heap < memory.heapCount(); heap++) {
+        auto& stats = memory.budget(heap).statistics;
+        m_waste += stats.blockBytes - stats.allocationBytes;
+    }
+    m_lastWaste = std::min(m_lastWaste, m_waste);
+    if (m_waste > m_lastWaste + DEFRAG_MIN_WASTE) m_requested = true;
+}
+
+void Defragmenter::begin() {
+    VmaDefragmentationInfo info = {};
+    info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+    info.maxBytesPerPass = m_budgetBytes;
+    info.maxAllocationsPerPass = DEFRAG_MAX_MOVES_PER_PASS;
+    VK_CHECK(vmaBeginDefragmentation(m_allocator, &info, &m_context));
+    m_emptyPasses = 0;
+}
+
+void Defragmenter::record(VkCommandBuffer cmd, uint64_t frameValue) {
+    if (m_passPending) return;
+    if (!running()) {
+        if (!m_requested) return;
+        m_requested = false;
+        if (m_byAllocation.empty()) return; // nothing that could move
+        begin();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto e = vmaBeginDefragmentationPass(m_allocator, m_context, &m_pass);
+    if (e == VK_SUCCESS) {
+        // nothing left to move
+        end();
+        return;
+    }
+    if (e != VK_INCOMPLETE) VK_CHECK(e);
+
+    ArenaScope scope(vkutil::scratch());
+    std::pmr::vector<Copy> copies(&vkutil::scratch());
+    copies.reserve(m_pass.moveCount);
+
+    BarrierBatch release;
+    for (uint32_t i = 0; i < m_pass.moveCount; i++) {
+        auto& move = m_pass.pMoves[i];
+
+        // unregistered allocations stay put, and once over the time budget so does the rest of the pass
+        auto it = m_byAllocation.find(move.srcAllocation);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (it == m_byAllocation.end() || (!copies.empty() && ms > m_budgetMs)) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+        recordMove(move, it->second, release, copies);
+    }
+
+    if (copies.empty()) {
+        // only this pass is over, vma sets aside what was ignored and offers other moves on the next frame.
+        // a run that keeps turning up unregistered allocations gives up rather than polling every frame
+        m_emptyPasses++;
+        if (vmaEndDefragmentationPass(m_allocator, m_context, &m_pass) == VK_SUCCESS || m_emptyPasses >= DEFRAG_MAX_EMPTY_PASSES) end();
+        return;
+    }
+    m_emptyPasses = 0;
+
+    // hand the old resources over to the transfer queue at the end of this frame, which the copies wait on
+    release.flush(cmd);
+    m_uploads->waitFor(m_device, m_timeline, frameValue);
+    m_passToken = m_uploads->enqueue(m_device, [&](VkCommandBuffer uploadCmd) {
+        recordCopies(uploadCmd, copies);
+    });
+
+    // and the new ones back to graphics, the next frame acquires them and waits for the copies
+    for (auto& copy : copies) {
+        auto& res = m_resources[copy.id];
+        if (copy.dstImg) {
+            m_uploads->releaseImage(m_device, copy.dstImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, res.layout,
+                VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT, full_range(res.imgInfo));
+        } else {
+            m_uploads->releaseBuffer(m_device, copy.dstBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+        }
+    }
+
+    m_passValue = frameValue;
+    m_passPending = true;
+    m_passUnsubmitted = true;
+    m_stats.passes++;
+}
+
+void Defragmenter::recordMove(const VmaDefragmentationMove& move, DefragId id, BarrierBatch& release, std::pmr::vector<Copy>& copies) {
+    auto& res = m_resources[id];
+    uint32_t graphicsFamily = m_uploads->graphicsQueueFamily();
+    uint32_t transferFamily = m_uploads->queueFamily();
+    bool transfer = graphicsFamily != transferFamily;
+
+    Move old = { id, res.img, res.buffer.buffer, res.bindlessIndex };
+    Copy copy = { id };
+
+    if (res.img.img) {
+        VkImage img;
+        VK_CHECK(vkCreateImage(m_device, &res.imgInfo, nullptr, &img));
+        VK_CHECK(vmaBindImageMemory(m_allocator, move.dstTmpAllocation, img));
+
+        auto range = full_range(res.imgInfo);
+        auto viewInfo = vkinit::imgview_create_info(res.img.format, img, range.aspectMask & ~VK_IMAGE_ASPECT_STENCIL_BIT);
+        viewInfo.viewType = view_type(res.imgInfo);
+        viewInfo.subresourceRange.levelCount = range.levelCount;
+        viewInfo.subresourceRange.layerCount = range.layerCount;
+        VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &res.img.view));
+
+        // same family needs no release, the copy's semaphore wait covers it
+        if (transfer) {
+            release.image(res.img.img, res.layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                VK_ACCESS_2_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, range, graphicsFamily, transferFamily);
+        }
+
+        copy.srcImg = res.img.img;
+        copy.dstImg = img;
+        res.img.img = img;
+    } else {
+        VkBuffer buffer;
+        VK_CHECK(vkCreateBuffer(m_device, &res.bufferInfo, nullptr, &buffer));
+        VK_CHECK(vmaBindBufferMemory(m_allocator, move.dstTmpAllocation, buffer));
+
+        if (transfer) {
+            release.buffer(res.buffer.buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, 0, VK_WHOLE_SIZE, graphicsFamily, transferFamily);
+        }
+
+        copy.srcBuffer = res.buffer.buffer;
+        copy.dstBuffer = buffer;
+        res.buffer.buffer = buffer;
+    }
+
+    // a fresh slot rather than rewriting the old one, which frames still in flight may be reading
+    switch (res.bindlessType) {
+    case BindlessType::SampledImage: res.bindlessIndex = m_bindless->addSampledImage(m_device, res.img.view, res.layout); break;
+    case BindlessType::StorageImage: res.bindlessIndex = m_bindless->addStorageImage(m_device, res.img.view); break;
+    case BindlessType::StorageBuffer: res.bindlessIndex = m_bindless->addStorageBuffer(m_device, res.buffer.buffer); break;
+    default: break;
+    }
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(m_allocator, move.srcAllocation, &info);
+    m_stats.moves++;
+    m_stats.bytesMoved += info.size;
+
+    res.moving = true;
+    m_moves.push_back(old);
+    copies.push_back(copy);
+}
+
+void Defragmenter::recordCopies(VkCommandBuffer cmd, std::span<const Copy> copies) {
+    bool transfer = m_uploads->graphicsQueueFamily() != m_uploads->queueFamily();
+    uint32_t srcFamily = transfer ? m_uploads->graphicsQueueFamily() : VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dstFamily = transfer ? m_uploads->queueFamily() : VK_QUEUE_FAMILY_IGNORED;
+
+    // acquire the old resources (or just transition them, on a shared family) and ready the new imgs
+    BarrierBatch barriers;
+    for (auto& copy : copies) {
+        auto& res = m_resources[copy.id];
+        if (copy.dstImg) {
+            auto range = full_range(res.imgInfo);
+            barriers.image(copy.srcImg, res.layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                transfer ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE,
+                VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, range, srcFamily, dstFamily);
+            barriers.image(copy.dstImg, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, range);
+        } else if (transfer) {
+            barriers.buffer(copy.srcBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+                VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, 0, VK_WHOLE_SIZE, srcFamily, dstFamily);
+        }
+    }
+    barriers.flush(cmd);
+
+    for (auto& copy : copies) {
+        auto& res = m_resources[copy.id];
+        if (copy.dstImg) {
+            // every mip, all layers at once
+            VkImageCopy regions[16];
+            uint32_t mips = std::min(res.imgInfo.mipLevels, 16u);
+            for (uint32_t mip = 0; mip < mips; mip++) {
+                VkImageCopy& region = regions[mip];
+                region = {};
+                region.srcSubresource = { aspect_flags(res.imgInfo.format), mip, 0, res.imgInfo.arrayLayers };
+                region.dstSubresource = region.srcSubresource;
+                region.extent = {
+                    std::max(res.imgInfo.extent.width >> mip, 1u),
+                    std::max(res.imgInfo.extent.height >> mip, 1u),
+                    std::max(res.imgInfo.extent.depth >> mip, 1u),
+                };
+            }
+            vkCmdCopyImage(cmd, copy.srcImg, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.dstImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mips, regions);
+        } else {
+            VkBufferCopy region = { 0, 0, res.bufferInfo.size };
+            vkCmdCopyBuffer(cmd, copy.srcBuffer, copy.dstBuffer, 1, &region);
+        }
+    }
+}
+
+void Defragmenter::endPass() {
+    // nothing reads the old handles any more, and their memory goes back to vma below
+    for (auto& move : m_moves) {
+        if (move.oldImg.img) {
+            vkDestroyImageView(m_device, move.oldImg.view, nullptr);
+            vkDestroyImage(m_device, move.oldImg.img, nullptr);
+        } else {
+            vkDestroyBuffer(m_device, move.oldBuffer, nullptr);
+        }
+
+        auto& res = m_resources[move.id];
+        if (move.oldBindlessIndex != BINDLESS_INVALID) m_bindless->remove(res.bindlessType, move.oldBindlessIndex);
+        res.moving = false;
+    }
+    m_moves.clear();
+    m_passPending = false;
+
+    // srcAllocation now points at the new place, so the resources keep their VmaAllocation and tracking
+    if (vmaEndDefragmentationPass(m_allocator, m_context, &m_pass) == VK_SUCCESS) end();
+}
+
+void Defragmenter::end() {
+    VmaDefragmentationStats stats = {};
+    vmaEndDefragmentation(m_allocator, m_context, &stats);
+    m_context = VK_NULL_HANDLE;
+
+    m_stats.runs++;
+    m_stats.bytesFreed += stats.bytesFreed;
+    m_lastWaste = m_waste > stats.bytesFreed ? m_waste - stats.bytesFreed : 0;
+    if (stats.allocationsMoved) {
+        fmt::print("defragmented {} allocations, {:.1f} MB moved, {:.1f} MB freed\n",
+            stats.allocationsMoved, stats.bytesMoved / MB, stats.bytesFreed / MB);
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "vk_common.h"
+#include "vk_bindless.h"
+#include "vk_memory.h"
+#include "vk_upload.h"
+
+#include <memory_resource>
+#include <unordered_map>
+
+// id of a resource registered with the Defragmenter, stable across moves
+using DefragId = uint32_t;
+constexpr DefragId DEFRAG_INVALID = UINT32_MAX;
+
+constexpr float DEFRAG_FRAME_BUDGET_MS = 0.5f; // cpu time per frame spent recreating and recording moves
+constexpr VkDeviceSize DEFRAG_FRAME_BUDGET_BYTES = 8 * 1024 * 1024; // copied per frame on the transfer queue
+constexpr uint32_t DEFRAG_MAX_MOVES_PER_PASS = 64;
+constexpr VkDeviceSize DEFRAG_MIN_WASTE = 32 * 1024 * 1024; // free bytes inside a heap's blocks before a run starts
+constexpr uint32_t DEFRAG_CHECK_INTERVAL = 120; // frames between fragmentation checks
+constexpr uint32_t DEFRAG_MAX_EMPTY_PASSES = 16; // passes in a row with nothing registered to move before a run gives up
+
+// incremental defragmentation of the default VMA pools, at most one pass in flight and each pass bounded in
+// bytes and cpu time so a long run is spread over many frames instead of one hitch. only registered resources
+// are moved, everything else is skipped: they're recreated at the new place, copied on the transfer queue, and
+// their bindless slot swapped for one pointing at the new handles. registered resources have to be read only
+// on the gpu between uploads, not mapped, and not reached by device address, and owners must read the handles
+// and bindless index through the id each frame rather than keeping copies.
+// the renderer doesn't register anything yet: its draw imgs are written every frame, and the suballocator
+// blocks and frame ring are mapped or reached by device address. until something does, runs don't start
+struct Defragmenter {
+    struct Stats {
+        uint32_t runs = 0;
+        uint32_t passes = 0;
+        uint64_t moves = 0;
+        VkDeviceSize bytesMoved = 0;
+        VkDeviceSize bytesFreed = 0;
+    };
+
+    void init(VkDevice device, VmaAllocator allocator, VkSemaphore timeline, BindlessHeap* bindless, UploadService* uploads);
+    // expects the gpu to be idle
+    void destroy();
+
+    // info is what the resource was created with, which needs transfer src and dst usage and exclusive sharing.
+    // img has to be in layout whenever the gpu isn't writing it, bindless is the slot type that points at it
+    // (Count for none). buffers must not have VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+    DefragId registerImage(const AllocatedImg& img, const VkImageCreateInfo& info, VkImageLayout layout,
+        BindlessType bindless = BindlessType::Count, uint32_t bindlessIndex = BINDLESS_INVALID);
+    DefragId registerBuffer(const AllocatedBuffer& buffer, const VkBufferCreateInfo& info,
+        BindlessType bindless = BindlessType::Count, uint32_t bindlessIndex = BINDLESS_INVALID);
+    // stops tracking the resource, which the caller then destroys (through the RetireQueue) as usual.
+    // waits for the pass in flight if it's moving the resource, so take the handles after this returns.
+    // that wait is on the frame record() was given, so between record() and the next update() (before the
+    // frame is submitted) it would never return, and unregistering a moving resource there aborts instead
+    void unregister(DefragId id);
+
+    const AllocatedImg& image(DefragId id) const { return m_resources[id].img; }
+    const AllocatedBuffer& buffer(DefragId id) const { return m_resources[id].buffer; }
+    uint32_t bindlessIndex(DefragId id) const { return m_resources[id].bindlessIndex; }
+
+    // starts a run on the next record
+    void request() { m_requested = true; }
+
+    // call once a frame after the frame's wait. finishes the pass in flight once the gpu is done with it, and
+    // every DEFRAG_CHECK_INTERVAL frames starts a run if a heap's blocks are wasting more than DEFRAG_MIN_WASTE
+    void update(uint64_t frameNum, const MemoryBudget& memory);
+
+    // records the next pass, the graphics side of it (queue ownership releases) goes into cmd, which has to be
+    // the last cmd of the frame that signals frameValue. call after UploadService::recordAcquires for the frame
+    void record(VkCommandBuffer cmd, uint64_t frameValue);
+
+    // budgets for the next run
+    void setBudget(float ms, VkDeviceSize bytes) { m_budgetMs = ms; m_budgetBytes = bytes; }
+
+    // runs started by update() when fragmentation builds up, request() works either way
+    void setAutomatic(bool enabled) { m_automatic = enabled; }
+    bool automatic() const { return m_automatic; }
+
+    bool running() const { return m_context != VK_NULL_HANDLE; }
+    size_t registered() const { return m_byAllocation.size(); }
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Resource {
+        AllocatedImg img = {}; // img.img is null for buffers
+        AllocatedBuffer buffer = {};
+        VkImageCreateInfo imgInfo = {};
+        VkBufferCreateInfo bufferInfo = {};
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        BindlessType bindlessType = BindlessType::Count;
+        uint32_t bindlessIndex = BINDLESS_INVALID;
+        bool moving = false;
+    };
+
+    // what a move replaced, freed once the pass is done
+    struct Move {
+        DefragId id;
+        AllocatedImg oldImg;
+        VkBuffer oldBuffer;
+        uint32_t oldBindlessIndex;
+    };
+
+    // recorded into the upload batch, old to new
+    struct Copy {
+        DefragId id;
+        VkImage srcImg, dstImg;
+        VkBuffer srcBuffer, dstBuffer;
+    };
+
+    DefragId add(const Resource& res, VmaAllocation allocation);
+    void begin();
+    // recreates the resource at the move's destination and switches it over to the new handles
+    void recordMove(const VmaDefragmentationMove& move, DefragId id, BarrierBatch& release, std::pmr::vector<Copy>& copies);
+    void recordCopies(VkCommandBuffer cmd, std::span<const Copy> copies);
+    void endPass(); // the pass's copies and last readers of the old handles must have completed
+    void end();
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    VkSemaphore m_timeline = VK_NULL_HANDLE;
+    BindlessHeap* m_bindless = nullptr;
+    UploadService* m_uploads = nullptr;
+
+    std::vector<Resource> m_resources; // indexed by DefragId
+    std::vector<DefragId> m_freeIds;
+    std::unordered_map<VmaAllocation, DefragId> m_byAllocation; // vma user data is taken by the memory category
+
+    VmaDefragmentationContext m_context = VK_NULL_HANDLE;
+    VmaDefragmentationPassMoveInfo m_pass = {};
+    bool m_passPending = false;
+    bool m_passUnsubmitted = false; // recorded this frame, cleared by the next update()
+    uint32_t m_emptyPasses = 0; // in a row, this run
+    uint64_t m_passValue = 0; // frame that last used the old handles
+    UploadToken m_passToken = 0; // batch holding the copies
+    std::vector<Move> m_moves;
+
+    bool m_automatic = true;
+    bool m_requested = false;
+    VkDeviceSize m_waste = 0; // free bytes inside vma's blocks at the last check
+    VkDeviceSize m_lastWaste = 0; // left over by the last run, the next one waits until it grows by DEFRAG_MIN_WASTE
+    float m_budgetMs = DEFRAG_FRAME_BUDGET_MS;
+    VkDeviceSize m_budgetBytes = DEFRAG_FRAME_BUDGET_BYTES;
+    Stats m_stats;
+};
@@ -1,9 +1,12 @@
 #include "vk_descriptors.h"
+#include "vk_arena.h"
+#include "vk_buffers.h"
+#include "vk_initialisers.h"
 
-void DescriptorLayoutBuilder::addBinding(uint32_t binding, VkDescriptorType type) {
+void DescriptorLayoutBuilder::addBinding(uint32_t binding, VkDescriptorType type, uint32_t count) {
     VkDescriptorSetLayoutBinding newbind = {};
     newbind.binding = binding;
-    newbind.descriptorCount = 1;
+    newbind.descriptorCount = count;
     newbind.descriptorType = type;
     m_bindings.push_back(newbind);
 }
@@ -30,41 +33,282 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device, VkShaderSt
 }
 
 void DescriptorAllocator::initPool(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios) {
-    std::vector<VkDescriptorPoolSize> poolSizes;
-    for (auto ratio : poolRatios) {
+    m_ratios.assign(poolRatios.begin(), poolRatios.end());
+
+    m_readyPools.push_back(createPool(device, maxSets));
+    m_setsPerPool = std::min(maxSets + maxSets / 2, MAX_SETS_PER_POOL);
+}
+
+void DescriptorAllocator::clearDescriptors(VkDevice device) {
+    // resetting keeps the pools, so a frame that needed several doesn't create them again
+    for (auto pool : m_readyPools) vkResetDescriptorPool(device, pool, 0);
+    for (auto pool : m_fullPools) {
+        vkResetDescriptorPool(device, pool, 0);
+        m_readyPools.push_back(pool);
+    }
+    m_fullPools.clear();
+}
+
+void DescriptorAllocator::destroyPool(VkDevice device) {
+    for (auto pool : m_readyPools) vkDestroyDescriptorPool(device, pool, nullptr);
+    for (auto pool : m_fullPools) vkDestroyDescriptorPool(device, pool, nullptr);
+    m_readyPools.clear();
+    m_fullPools.clear();
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDevice device, VkDescriptorSetLayout layout, void* pNext) {
+    VkDescriptorPool pool = getPool(device);
+
+    VkDescriptorSetAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    info.pNext = pNext;
+    info.descriptorPool = pool;
+    info.descriptorSetCount = 1;
+    info.pSetLayouts = &layout;
+
+    VkDescriptorSet dSet;
+    VkResult res = vkAllocateDescriptorSets(device, &info, &dSet);
+
+    // pool is exhausted, retire it until the next clear and retry once with a fresh one
+    if (res == VK_ERROR_OUT_OF_POOL_MEMORY || res == VK_ERROR_FRAGMENTED_POOL) {
+        m_fullPools.push_back(pool);
+        pool = getPool(device);
+        info.descriptorPool = pool;
+        VK_CHECK(vkAllocateDescriptorSets(device, &info, &dSet));
+    } else {
+        VK_CHECK(res);
+    }
+
+    m_readyPools.push_back(pool);
+    return dSet;
+}
+
+VkDescriptorPool DescriptorAllocator::getPool(VkDevice device) {
+    if (!m_readyPools.empty()) {
+        VkDescriptorPool pool = m_readyPools.back();
+        m_readyPools.pop_back();
+        return pool;
+    }
+
+    VkDescriptorPool pool = createPool(device, m_setsPerPool);
+    m_setsPerPool = std::min(m_setsPerPool + m_setsPerPool / 2, MAX_SETS_PER_POOL);
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(VkDevice device, uint32_t setCount) {
+    ArenaScope scope(vkutil::scratch());
+    std::pmr::vector<VkDescriptorPoolSize> poolSizes(&vkutil::scratch());
+    poolSizes.reserve(m_ratios.size());
+    for (auto ratio : m_ratios) {
         poolSizes.push_back(VkDescriptorPoolSize{
             .type = ratio.type,
-            .descriptorCount = uint32_t(ratio.ratio * maxSets)
+            .descriptorCount = std::max(uint32_t(ratio.ratio * setCount), 1u)
         });
     }
 
 	VkDescriptorPoolCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	info.flags = 0;
-	info.maxSets = maxSets;
+	info.maxSets = setCount;
 	info.poolSizeCount = (uint32_t)poolSizes.size();
 	info.pPoolSizes = poolSizes.data();
 
-	vkCreateDescriptorPool(device, &info, nullptr, &pool);
+	VkDescriptorPool pool;
+	VK_CHECK(vkCreateDescriptorPool(device, &info, nullptr, &pool));
+	return pool;
 }
 
-void DescriptorAllocator::clearDescriptors(VkDevice device) {
-    vkResetDescriptorPool(device, pool, 0);
+void DescriptorBuffer::init(VkDevice device, VkPhysicalDevice physDev, VmaAllocator allocator, VkDeviceSize size) {
+    // extension entry points aren't exported by the loader
+    m_getLayoutSize = (PFN_vkGetDescriptorSetLayoutSizeEXT)vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutSizeEXT");
+    m_getBindingOffset = (PFN_vkGetDescriptorSetLayoutBindingOffsetEXT)vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutBindingOffsetEXT");
+    m_getDescriptor = (PFN_vkGetDescriptorEXT)vkGetDeviceProcAddr(device, "vkGetDescriptorEXT");
+    m_cmdBindBuffers = (PFN_vkCmdBindDescriptorBuffersEXT)vkGetDeviceProcAddr(device, "vkCmdBindDescriptorBuffersEXT");
+    m_cmdSetOffsets = (PFN_vkCmdSetDescriptorBufferOffsetsEXT)vkGetDeviceProcAddr(device, "vkCmdSetDescriptorBufferOffsetsEXT");
+
+    m_props = {};
+    m_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 props = {};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &m_props;
+    vkGetPhysicalDeviceProperties2(physDev, &props);
+
+    m_size = size;
+    m_head = 0;
+    m_buffer = vkutil::create_buffer(allocator, size,
+        VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, 0, MemoryCategory::Descriptors);
+
+    VkBufferDeviceAddressInfo addressInfo = {};
+    addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    addressInfo.buffer = m_buffer.buffer;
+    m_address = vkGetBufferDeviceAddress(device, &addressInfo);
 }
 
-void DescriptorAllocator::destroyPool(VkDevice device) {
-    vkDestroyDescriptorPool(device, pool, nullptr);
+void DescriptorBuffer::destroy(VmaAllocator allocator) {
+    vkutil::destroy_buffer(allocator, m_buffer);
+    m_buffer = {};
 }
 
-VkDescriptorSet DescriptorAllocator::allocate(VkDevice device, VkDescriptorSetLayout layout) {
-    VkDescriptorSetAllocateInfo info = {};
-    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    info.pNext = nullptr;
-    info.descriptorPool = pool;
-    info.descriptorSetCount = 1;
-    info.pSetLayouts = &layout;
+VkDeviceSize DescriptorBuffer::allocate(VkDevice device, VkDescriptorSetLayout layout) {
+    VkDeviceSize layoutSize = 0;
+    m_getLayoutSize(device, layout, &layoutSize);
 
-    VkDescriptorSet dSet;
-    VK_CHECK(vkAllocateDescriptorSets(device, &info, &dSet));
-    return dSet;
-}
\ No newline at end of file
+    VkDeviceSize alignment = m_props.descriptorBufferOffsetAlignment;
+    VkDeviceSize offset = (m_head + alignment - 1) & ~(alignment - 1);
+    if (offset + layoutSize > m_size) {
+        fmt::print("descriptor buffer out of space ({} bytes)\n", m_size);
+        abort();
+    }
+    m_head = offset + layoutSize;
+    return offset;
+}
+
+size_t DescriptorBuffer::descriptorSize(VkDescriptorType type) const {
+    switch (type) {
+    case VK_DESCRIPTOR_TYPE_SAMPLER: return m_props.samplerDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: return m_props.combinedImageSamplerDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE: return m_props.sampledImageDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: return m_props.storageImageDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: return m_props.uniformBufferDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: return m_props.storageBufferDescriptorSize;
+    default:
+        fmt::print("descriptor buffer doesn't handle {}\n", string_VkDescriptorType(type));
+        abort();
+    }
+}
+
+void* DescriptorBuffer::descriptorPtr(VkDevice device, VkDescriptorSetLayout layout, VkDeviceSize set, uint32_t binding,
+    VkDescriptorType type, uint32_t arrayElement) {
+    VkDeviceSize bindingOffset = 0;
+    m_getBindingOffset(device, layout, binding, &bindingOffset);
+    return (char*)m_buffer.info.pMappedData + set + bindingOffset + arrayElement * descriptorSize(type);
+}
+
+void DescriptorBuffer::writeImage(VkDevice device, VkDescriptorSetLayout layout, VkDeviceSize set, uint32_t binding, VkDescriptorType type,
+    VkImageView view, VkImageLayout imgLayout, VkSampler sampler, uint32_t arrayElement) {
+    VkDescriptorImageInfo imgInfo = { sampler, view, imgLayout };
+
+    VkDescriptorGetInfoEXT info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+    info.type = type;
+    switch (type) {
+    case VK_DESCRIPTOR_TYPE_SAMPLER: info.data.pSampler = &sampler; break;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: info.data.pCombinedImageSampler = &imgInfo; break;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE: info.data.pSampledImage = &imgInfo; break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: info.data.pStorageImage = &imgInfo; break;
+    default: break;
+    }
+    m_getDescriptor(device, &info, descriptorSize(type), descriptorPtr(device, layout, set, binding, type, arrayElement));
+}
+
+void DescriptorBuffer::writeBuffer(VkDevice device, VkDescriptorSetLayout layout, VkDeviceSize set, uint32_t binding, VkDescriptorType type,
+    VkDeviceAddress address, VkDeviceSize range, uint32_t arrayElement) {
+    if (range == VK_WHOLE_SIZE) {
+        fmt::print("descriptor buffer: buffer descriptors need an explicit range, not VK_WHOLE_SIZE\n");
+        abort();
+    }
+
+    VkDescriptorAddressInfoEXT addressInfo = {};
+    addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+    addressInfo.address = address;
+    addressInfo.range = range;
+    addressInfo.format = VK_FORMAT_UNDEFINED;
+
+    VkDescriptorGetInfoEXT info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+    info.type = type;
+    if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) info.data.pUniformBuffer = &addressInfo;
+    else info.data.pStorageBuffer = &addressInfo;
+    m_getDescriptor(device, &info, descriptorSize(type), descriptorPtr(device, layout, set, binding, type, arrayElement));
+}
+
+void DescriptorBuffer::bind(VkCommandBuffer cmd) {
+    VkDescriptorBufferBindingInfoEXT bindingInfo = {};
+    bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+    bindingInfo.address = m_address;
+    bindingInfo.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+    m_cmdBindBuffers(cmd, 1, &bindingInfo);
+}
+
+void DescriptorBuffer::setOffset(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set, VkDeviceSize offset) {
+    uint32_t bufferIndex = 0;
+    m_cmdSetOffsets(cmd, bindPoint, layout, set, 1, &bufferIndex, &offset);
+}
+
+void TransientDescriptors::init(VkDevice device, VkPhysicalDevice physDev, VmaAllocator allocator, bool descriptorBuffers) {
+    m_descriptorBuffers = descriptorBuffers;
+    if (m_descriptorBuffers) {
+        m_buffer.init(device, physDev, allocator, 4 * 1024 * 1024);
+        return;
+    }
+
+    std::vector<DescriptorAllocator::PoolSizeRatio> sizes = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+    };
+    m_pools.initPool(device, 1000, sizes);
+}
+
+void TransientDescriptors::destroy(VkDevice device, VmaAllocator allocator) {
+    if (m_descriptorBuffers) m_buffer.destroy(allocator);
+    else m_pools.destroyPool(device);
+}
+
+void TransientDescriptors::clear(VkDevice device) {
+    if (m_descriptorBuffers) m_buffer.clear();
+    else m_pools.clearDescriptors(device);
+}
+
+TransientDescriptors::Set TransientDescriptors::allocate(VkDevice device, VkDescriptorSetLayout layout) {
+    Set set = {};
+    if (m_descriptorBuffers) set.offset = m_buffer.allocate(device, layout);
+    else set.set = m_pools.allocate(device, layout);
+    return set;
+}
+
+void TransientDescriptors::writeImage(VkDevice device, VkDescriptorSetLayout layout, Set set, uint32_t binding, VkDescriptorType type,
+    VkImageView view, VkImageLayout imgLayout, VkSampler sampler) {
+    if (m_descriptorBuffers) {
+        m_buffer.writeImage(device, layout, set.offset, binding, type, view, imgLayout, sampler);
+        return;
+    }
+
+    VkDescriptorImageInfo imgInfo = { sampler, view, imgLayout };
+    auto write = vkinit::write_descriptor_image(type, set.set, &imgInfo, binding);
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+void TransientDescriptors::writeBuffer(VkDevice device, VkDescriptorSetLayout layout, Set set, uint32_t binding, VkDescriptorType type,
+    VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    if (m_descriptorBuffers) {
+        VkBufferDeviceAddressInfo addressInfo = {};
+        addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+        addressInfo.buffer = buffer;
+        m_buffer.writeBuffer(device, layout, set.offset, binding, type, vkGetBufferDeviceAddress(device, &addressInfo) + offset, range);
+        return;
+    }
+
+    VkDescriptorBufferInfo bufferInfo = { buffer, offset, range };
+    auto write = vkinit::write_descriptor_buffer(type, set.set, &bufferInfo, binding);
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+void TransientDescriptors::begin(VkCommandBuffer cmd) {
+    if (m_descriptorBuffers) m_buffer.bind(cmd);
+}
+
+void TransientDescriptors::bindSet(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t index, Set set) {
+    if (m_descriptorBuffers) m_buffer.setOffset(cmd, bindPoint, layout, index, set.offset);
+    else vkCmdBindDescriptorSets(cmd, bindPoint, layout, index, 1, &set.set, 0, nullptr);
+}
+
+VkDescriptorSetLayoutCreateFlags TransientDescriptors::layoutFlags() const {
+    return m_descriptorBuffers ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
+}
+
+VkPipelineCreateFlags TransientDescriptors::pipelineFlags() const {
+    return m_descriptorBuffers ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT : 0;
+}
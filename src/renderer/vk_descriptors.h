@@ -2,23 +2,108 @@
 #include "vk_common.h"
 
 struct DescriptorLayoutBuilder {
-    void addBinding(uint32_t binding, VkDescriptorType type);
+    void addBinding(uint32_t binding, VkDescriptorType type, uint32_t count = 1);
     void clear();
     VkDescriptorSetLayout build(VkDevice device, VkShaderStageFlags shaderStages, void* pNext = nullptr, VkDescriptorSetLayoutCreateFlags flags = 0);
     private:
         std::vector<VkDescriptorSetLayoutBinding> m_bindings;
 };
 
+// growable allocator, chains a new (bigger) pool whenever the current one runs out.
+// clearDescriptors resets every pool at once, so transient sets cost a bump allocation
 struct DescriptorAllocator {
     struct PoolSizeRatio{
 		    VkDescriptorType type;
 		    float ratio;
     };
 
-    VkDescriptorPool pool;
-
+    // maxSets is the size of the first pool, later ones grow by half up to MAX_SETS_PER_POOL
     void initPool(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios);
     void clearDescriptors(VkDevice device);
     void destroyPool(VkDevice device);
-    VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout);
-};
\ No newline at end of file
+    VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout, void* pNext = nullptr);
+
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4092;
+
+private:
+    VkDescriptorPool getPool(VkDevice device);
+    VkDescriptorPool createPool(VkDevice device, uint32_t setCount);
+
+    std::vector<PoolSizeRatio> m_ratios;
+    std::vector<VkDescriptorPool> m_fullPools;
+    std::vector<VkDescriptorPool> m_readyPools;
+    uint32_t m_setsPerPool = 0;
+};
+
+// VK_EXT_descriptor_buffer backend, sets are bump allocated from one host visible buffer and
+// written with vkGetDescriptorEXT, so there are no pools and no vkUpdateDescriptorSets.
+// layouts used with it need VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT, and
+// pipelines VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+struct DescriptorBuffer {
+    void init(VkDevice device, VkPhysicalDevice physDev, VmaAllocator allocator, VkDeviceSize size);
+    void destroy(VmaAllocator allocator);
+
+    // returns the set's offset into the buffer
+    VkDeviceSize allocate(VkDevice device, VkDescriptorSetLayout layout);
+    void clear() { m_head = 0; }
+
+    void writeImage(VkDevice device, VkDescriptorSetLayout layout, VkDeviceSize set, uint32_t binding, VkDescriptorType type,
+        VkImageView view, VkImageLayout imgLayout, VkSampler sampler = VK_NULL_HANDLE, uint32_t arrayElement = 0);
+    // range has to be the real size, descriptors made from an address have no buffer to resolve VK_WHOLE_SIZE against
+    void writeBuffer(VkDevice device, VkDescriptorSetLayout layout, VkDeviceSize set, uint32_t binding, VkDescriptorType type,
+        VkDeviceAddress address, VkDeviceSize range, uint32_t arrayElement = 0);
+
+    // bind once per cmd buffer, then point each set at its offset
+    void bind(VkCommandBuffer cmd);
+    void setOffset(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set, VkDeviceSize offset);
+
+private:
+    size_t descriptorSize(VkDescriptorType type) const;
+    void* descriptorPtr(VkDevice device, VkDescriptorSetLayout layout, VkDeviceSize set, uint32_t binding, VkDescriptorType type, uint32_t arrayElement);
+
+    PFN_vkGetDescriptorSetLayoutSizeEXT m_getLayoutSize = nullptr;
+    PFN_vkGetDescriptorSetLayoutBindingOffsetEXT m_getBindingOffset = nullptr;
+    PFN_vkGetDescriptorEXT m_getDescriptor = nullptr;
+    PFN_vkCmdBindDescriptorBuffersEXT m_cmdBindBuffers = nullptr;
+    PFN_vkCmdSetDescriptorBufferOffsetsEXT m_cmdSetOffsets = nullptr;
+
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT m_props = {};
+    AllocatedBuffer m_buffer = {};
+    VkDeviceAddress m_address = 0;
+    VkDeviceSize m_size = 0;
+    VkDeviceSize m_head = 0;
+};
+
+// transient sets through the descriptor buffer when the device supports it, or the pool path when it doesn't.
+// create layouts with layoutFlags() and pipelines with pipelineFlags() so they match the backend in use
+struct TransientDescriptors {
+    struct Set {
+        VkDescriptorSet set = VK_NULL_HANDLE; // pool path
+        VkDeviceSize offset = 0; // descriptor buffer path
+    };
+
+    void init(VkDevice device, VkPhysicalDevice physDev, VmaAllocator allocator, bool descriptorBuffers);
+    void destroy(VkDevice device, VmaAllocator allocator);
+    void clear(VkDevice device);
+
+    Set allocate(VkDevice device, VkDescriptorSetLayout layout);
+    void writeImage(VkDevice device, VkDescriptorSetLayout layout, Set set, uint32_t binding, VkDescriptorType type,
+        VkImageView view, VkImageLayout imgLayout, VkSampler sampler = VK_NULL_HANDLE);
+    // buffer needs VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT for the descriptor buffer path, which also
+    // can't take VK_WHOLE_SIZE as the range, so pass the size
+    void writeBuffer(VkDevice device, VkDescriptorSetLayout layout, Set set, uint32_t binding, VkDescriptorType type,
+        VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+    // call once per cmd buffer before any bindSet
+    void begin(VkCommandBuffer cmd);
+    void bindSet(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t index, Set set);
+
+    VkDescriptorSetLayoutCreateFlags layoutFlags() const;
+    VkPipelineCreateFlags pipelineFlags() const;
+    bool usesDescriptorBuffer() const { return m_descriptorBuffers; }
+
+private:
+    bool m_descriptorBuffers = false;
+    DescriptorAllocator m_pools;
+    DescriptorBuffer m_buffer;
+};
@@ -1,30 +1,106 @@
 #include "vk_images.h"
 #include "vk_initialisers.h"
 
-void vkutil::transition_img(VkCommandBuffer cmd, VkImage img, VkImageLayout currentLayout, VkImageLayout newLayout) {
-    VkImageMemoryBarrier2 imageBarrier = {};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    imageBarrier.pNext = nullptr;
+namespace {
+    VkImageMemoryBarrier2 img_barrier(VkImage img, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        VkImageSubresourceRange range, uint32_t srcQueueFamily, uint32_t dstQueueFamily) {
+        VkImageMemoryBarrier2 imageBarrier = {};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        imageBarrier.pNext = nullptr;
 
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+        imageBarrier.srcStageMask = srcStage;
+        imageBarrier.srcAccessMask = srcAccess;
+        imageBarrier.dstStageMask = dstStage;
+        imageBarrier.dstAccessMask = dstAccess;
 
-    imageBarrier.oldLayout = currentLayout;
-    imageBarrier.newLayout = newLayout;
+        imageBarrier.oldLayout = oldLayout;
+        imageBarrier.newLayout = newLayout;
+        imageBarrier.srcQueueFamilyIndex = srcQueueFamily;
+        imageBarrier.dstQueueFamilyIndex = dstQueueFamily;
 
-    VkImageAspectFlags aspectMask = (newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
-    imageBarrier.subresourceRange = vkinit::img_subresource_range(aspectMask);
-    imageBarrier.image = img;
+        imageBarrier.subresourceRange = range;
+        imageBarrier.image = img;
+        return imageBarrier;
+    }
+
+    // single barrier without going through a batch, so there's no allocation
+    void record_img_barrier(VkCommandBuffer cmd, const VkImageMemoryBarrier2& imageBarrier) {
+        VkDependencyInfo depInfo = {};
+        depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        depInfo.pNext = nullptr;
+        depInfo.imageMemoryBarrierCount = 1;
+        depInfo.pImageMemoryBarriers = &imageBarrier;
+
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
+} // namespace
+
+BarrierBatch& BarrierBatch::image(VkImage img, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+    VkImageSubresourceRange range, uint32_t srcQueueFamily, uint32_t dstQueueFamily) {
+    m_imgBarriers.push_back(img_barrier(img, oldLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess, range, srcQueueFamily, dstQueueFamily));
+    return *this;
+}
+
+BarrierBatch& BarrierBatch::buffer(VkBuffer buffer, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+    VkDeviceSize offset, VkDeviceSize size, uint32_t srcQueueFamily, uint32_t dstQueueFamily) {
+    VkBufferMemoryBarrier2 bufferBarrier = {};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    bufferBarrier.pNext = nullptr;
+
+    bufferBarrier.srcStageMask = srcStage;
+    bufferBarrier.srcAccessMask = srcAccess;
+    bufferBarrier.dstStageMask = dstStage;
+    bufferBarrier.dstAccessMask = dstAccess;
+
+    bufferBarrier.srcQueueFamilyIndex = srcQueueFamily;
+    bufferBarrier.dstQueueFamilyIndex = dstQueueFamily;
+
+    bufferBarrier.buffer = buffer;
+    bufferBarrier.offset = offset;
+    bufferBarrier.size = size;
+
+    m_bufferBarriers.push_back(bufferBarrier);
+    return *this;
+}
+
+void BarrierBatch::flush(VkCommandBuffer cmd) {
+    if (empty()) return;
 
     VkDependencyInfo depInfo = {};
     depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
     depInfo.pNext = nullptr;
-    depInfo.imageMemoryBarrierCount = 1;
-    depInfo.pImageMemoryBarriers = &imageBarrier;
+    depInfo.bufferMemoryBarrierCount = (uint32_t)m_bufferBarriers.size();
+    depInfo.pBufferMemoryBarriers = m_bufferBarriers.data();
+    depInfo.imageMemoryBarrierCount = (uint32_t)m_imgBarriers.size();
+    depInfo.pImageMemoryBarriers = m_imgBarriers.data();
 
     vkCmdPipelineBarrier2(cmd, &depInfo);
+
+    m_bufferBarriers.clear();
+    m_imgBarriers.clear();
+}
+
+void vkutil::transition_img(VkCommandBuffer cmd, VkImage img, VkImageLayout currentLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+    VkImageSubresourceRange range) {
+    record_img_barrier(cmd, img_barrier(img, currentLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess,
+        range, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED));
+}
+
+void vkutil::transfer_img_ownership(VkCommandBuffer cmd, VkImage img, VkImageLayout currentLayout, VkImageLayout newLayout,
+    uint32_t srcQueueFamily, uint32_t dstQueueFamily, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask, bool release) {
+    auto range = vkinit::img_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // the release only makes the writes available, the acquire makes them visible
+    if (release) {
+        record_img_barrier(cmd, img_barrier(img, currentLayout, newLayout, stageMask, accessMask, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+            range, srcQueueFamily, dstQueueFamily));
+    } else {
+        record_img_barrier(cmd, img_barrier(img, currentLayout, newLayout, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, stageMask, accessMask,
+            range, srcQueueFamily, dstQueueFamily));
+    }
 }
 
 void vkutil::copy_img_to_img(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize) {
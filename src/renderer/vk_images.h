@@ -1,8 +1,37 @@
 #pragma once
 #include "vk_common.h"
+#include "vk_initialisers.h"
+
+// collects img and buffer barriers with explicit stage/access masks, and records
+// them all with a single vkCmdPipelineBarrier2 on flush
+struct BarrierBatch {
+    BarrierBatch& image(VkImage img, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        VkImageSubresourceRange range = vkinit::img_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT),
+        uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+    BarrierBatch& buffer(VkBuffer buffer, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE,
+        uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+    bool empty() const { return m_imgBarriers.empty() && m_bufferBarriers.empty(); }
+
+    // records everything collected so far, then clears (keeping capacity)
+    void flush(VkCommandBuffer cmd);
+
+private:
+    std::vector<VkImageMemoryBarrier2> m_imgBarriers;
+    std::vector<VkBufferMemoryBarrier2> m_bufferBarriers;
+};
 
 namespace vkutil {
-    void transition_img(VkCommandBuffer cmd, VkImage img, VkImageLayout currentLayout, VkImageLayout newLayout);
+    void transition_img(VkCommandBuffer cmd, VkImage img, VkImageLayout currentLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        VkImageSubresourceRange range = vkinit::img_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT));
+    // queue family ownership transfer, recorded as the release on the src queue and again as the
+    // acquire on the dst queue with that queue's stage/access, layouts must match in both
+    void transfer_img_ownership(VkCommandBuffer cmd, VkImage img, VkImageLayout currentLayout, VkImageLayout newLayout,
+        uint32_t srcQueueFamily, uint32_t dstQueueFamily, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask, bool release);
     void copy_img_to_img(VkCommandBuffer cmd, VkImage src, VkImage dst, VkExtent2D srcSize, VkExtent2D dstSize);
     void gen_mipmaps(VkCommandBuffer cmd, VkImage img, VkExtent2D imgSize);
-} // namespace vkutil
\ No newline at end of file
+} // namespace vkutil
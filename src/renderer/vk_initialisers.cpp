@@ -52,24 +52,54 @@ VkSemaphoreCreateInfo vkinit::semaphore_create_info(VkSemaphoreCreateFlags flags
     return info;
 }
 
-VkSemaphoreSubmitInfo vkinit::semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore) {
+VkSemaphoreTypeCreateInfo vkinit::semaphore_type_create_info(VkSemaphoreType type, uint64_t initialValue) {
+    VkSemaphoreTypeCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    info.pNext = nullptr;
+    info.semaphoreType = type;
+    info.initialValue = initialValue;
+    return info;
+}
+
+VkSemaphoreSubmitInfo vkinit::semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore, uint64_t value) {
     VkSemaphoreSubmitInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
     info.pNext = nullptr;
 	info.semaphore = semaphore;
 	info.stageMask = stageMask;
 	info.deviceIndex = 0;
-	info.value = 1;
+	info.value = value; // ignored for binary semaphores
 	return info;
 }
 
-VkSubmitInfo2 vkinit::submit_info(VkCommandBufferSubmitInfo *cmd, VkSemaphoreSubmitInfo *signalSemaphoreInfo, VkSemaphoreSubmitInfo *waitSemaphoreInfo) {
+VkSemaphoreWaitInfo vkinit::semaphore_wait_info(const VkSemaphore* semaphore, const uint64_t* value) {
+    VkSemaphoreWaitInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    info.pNext = nullptr;
+    info.flags = 0;
+    info.semaphoreCount = 1;
+    info.pSemaphores = semaphore;
+    info.pValues = value;
+    return info;
+}
+
+VkQueryPoolCreateInfo vkinit::query_pool_create_info(VkQueryType type, uint32_t count) {
+    VkQueryPoolCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.pNext = nullptr;
+    info.queryType = type;
+    info.queryCount = count;
+    return info;
+}
+
+VkSubmitInfo2 vkinit::submit_info(VkCommandBufferSubmitInfo *cmd, VkSemaphoreSubmitInfo *signalSemaphoreInfo, VkSemaphoreSubmitInfo *waitSemaphoreInfo,
+    uint32_t signalCount, uint32_t waitCount) {
     VkSubmitInfo2 info = {};
     info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
     info.pNext = nullptr;
-    info.waitSemaphoreInfoCount = (waitSemaphoreInfo == nullptr) ? 0 : 1;
+    info.waitSemaphoreInfoCount = (waitSemaphoreInfo == nullptr) ? 0 : waitCount;
     info.pWaitSemaphoreInfos = waitSemaphoreInfo;
-    info.signalSemaphoreInfoCount = (signalSemaphoreInfo == nullptr) ? 0 : 1;
+    info.signalSemaphoreInfoCount = (signalSemaphoreInfo == nullptr) ? 0 : signalCount;
     info.pSignalSemaphoreInfos = signalSemaphoreInfo;
     info.commandBufferInfoCount = 1;
     info.pCommandBufferInfos = cmd;
@@ -83,13 +113,14 @@ VkPresentInfoKHR vkinit::present_info() {
     return info;
 }
 
-VkImageSubresourceRange vkinit::img_subresource_range(VkImageAspectFlags aspectMask) {
+VkImageSubresourceRange vkinit::img_subresource_range(VkImageAspectFlags aspectMask, uint32_t baseMip, uint32_t mipCount,
+    uint32_t baseLayer, uint32_t layerCount) {
     VkImageSubresourceRange subImage = {};
     subImage.aspectMask = aspectMask;
-    subImage.baseMipLevel = 0;
-    subImage.levelCount = VK_REMAINING_MIP_LEVELS;
-    subImage.baseArrayLayer = 0;
-    subImage.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    subImage.baseMipLevel = baseMip;
+    subImage.levelCount = mipCount;
+    subImage.baseArrayLayer = baseLayer;
+    subImage.layerCount = layerCount;
     return subImage;
 }
 
@@ -169,3 +200,17 @@ VkWriteDescriptorSet vkinit::write_descriptor_image(VkDescriptorType type, VkDes
     
     return write;
 }
+
+VkWriteDescriptorSet vkinit::write_descriptor_buffer(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorBufferInfo *bufferInfo, uint32_t binding) {
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.pNext = nullptr;
+
+    write.dstBinding = binding;
+    write.dstSet = dstSet;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pBufferInfo = bufferInfo;
+    
+    return write;
+}
@@ -11,9 +11,14 @@ namespace vkinit {
     VkFenceCreateInfo fence_create_info(VkFenceCreateFlags flags = 0);
 
     VkSemaphoreCreateInfo semaphore_create_info(VkSemaphoreCreateFlags flags = 0);
-    VkSemaphoreSubmitInfo semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore);
+    VkSemaphoreTypeCreateInfo semaphore_type_create_info(VkSemaphoreType type, uint64_t initialValue = 0);
+    VkSemaphoreSubmitInfo semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore, uint64_t value = 1);
+    VkSemaphoreWaitInfo semaphore_wait_info(const VkSemaphore* semaphore, const uint64_t* value);
 
-    VkSubmitInfo2 submit_info(VkCommandBufferSubmitInfo* cmd, VkSemaphoreSubmitInfo* signalSemaphoreInfo, VkSemaphoreSubmitInfo* waitSemaphoreInfo);
+    VkQueryPoolCreateInfo query_pool_create_info(VkQueryType type, uint32_t count);
+
+    VkSubmitInfo2 submit_info(VkCommandBufferSubmitInfo* cmd, VkSemaphoreSubmitInfo* signalSemaphoreInfo, VkSemaphoreSubmitInfo* waitSemaphoreInfo,
+        uint32_t signalCount = 1, uint32_t waitCount = 1);
     VkPresentInfoKHR present_info();
 
     VkRenderingAttachmentInfo color_attachment_info(VkImageView view, VkClearValue* clear ,VkImageLayout layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
@@ -23,8 +28,10 @@ namespace vkinit {
     VkRenderingInfo rendering_info(VkExtent2D renderExtent, VkRenderingAttachmentInfo* colorAttachment, VkRenderingAttachmentInfo* depthAttachment);
 
     VkWriteDescriptorSet write_descriptor_image(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorImageInfo* imgInfo, uint32_t binding);
+    VkWriteDescriptorSet write_descriptor_buffer(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorBufferInfo* bufferInfo, uint32_t binding);
 
-    VkImageSubresourceRange img_subresource_range(VkImageAspectFlags aspectMask);
+    VkImageSubresourceRange img_subresource_range(VkImageAspectFlags aspectMask, uint32_t baseMip = 0, uint32_t mipCount = VK_REMAINING_MIP_LEVELS,
+        uint32_t baseLayer = 0, uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
 
     VkImageCreateInfo img_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent);
     VkImageViewCreateInfo imgview_create_info(VkFormat format, VkImage img, VkImageAspectFlags aspectFlags);
@@ -0,0 +1,113 @@
+#include "vk_memory.h"
+
+#include <imgui.h>
+#include <cstdio>
+
+namespace {
+    std::atomic<VkDeviceSize> g_trackedBytes[(size_t)MemoryCategory::Count];
+
+    constexpr float MB = 1024.0f * 1024.0f;
+} // namespace
+
+void vkutil::track_allocation(VmaAllocator allocator, VmaAllocation allocation, MemoryCategory category) {
+    // stored +1, so untagged allocations (null user data) are ignored by untrack
+    vmaSetAllocationUserData(allocator, allocation, (void*)((uintptr_t)category + 1));
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    g_trackedBytes[(size_t)category] += info.size;
+}
+
+void vkutil::untrack_allocation(VmaAllocator allocator, VmaAllocation allocation) {
+    if (!allocation) return;
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    uintptr_t tag = (uintptr_t)info.pUserData;
+    if (tag == 0 || tag > (uintptr_t)MemoryCategory::Count) return;
+    g_trackedBytes[tag - 1] -= info.size;
+}
+
+VkDeviceSize vkutil::tracked_bytes(MemoryCategory category) {
+    return g_trackedBytes[(size_t)category].load(std::memory_order_relaxed);
+}
+
+const char* vkutil::memory_category_name(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::Other: return "other";
+    case MemoryCategory::RenderTargets: return "render targets";
+    case MemoryCategory::Buffers: return "buffers";
+    case MemoryCategory::FrameData: return "frame data";
+    case MemoryCategory::Descriptors: return "descriptors";
+    default: return "?";
+    }
+}
+
+void MemoryBudget::init(VkPhysicalDevice physDev, VmaAllocator allocator, bool extBudget) {
+    m_allocator = allocator;
+    m_extBudget = extBudget;
+    vkGetPhysicalDeviceMemoryProperties(physDev, &m_props);
+    vmaGetHeapBudgets(m_allocator, m_budgets);
+}
+
+void MemoryBudget::update(uint64_t frameNum) {
+    vmaSetCurrentFrameIndex(m_allocator, (uint32_t)frameNum);
+    vmaGetHeapBudgets(m_allocator, m_budgets);
+
+    for (uint32_t heap = 0; heap < m_props.memoryHeapCount; heap++) {
+        auto& b = m_budgets[heap];
+        if (b.budget == 0) continue;
+
+        if ((float)b.usage > b.budget * MEMORY_EVICT_THRESHOLD) {
+            VkDeviceSize wanted = b.usage - (VkDeviceSize)(b.budget * MEMORY_EVICT_TARGET);
+            VkDeviceSize released = 0;
+            for (auto& evictor : m_evictors) {
+                if (released >= wanted) break;
+                released += evictor.fn(heap, wanted - released);
+            }
+        }
+
+        // past the budget the os starts paging, worth a line in the log when it starts
+        uint32_t bit = 1u << heap;
+        if (b.usage > b.budget && !(m_overBudget & bit)) {
+            fmt::print("warning: memory heap {} over budget, {:.1f} / {:.1f} MB\n", heap, b.usage / MB, b.budget / MB);
+            m_overBudget |= bit;
+        } else if (b.usage <= b.budget) {
+            m_overBudget &= ~bit;
+        }
+    }
+}
+
+void MemoryBudget::addEvictionCallback(int priority, EvictFn&& fn) {
+    auto it = std::upper_bound(m_evictors.begin(), m_evictors.end(), priority, [](int p, const Evictor& e) { return p < e.priority; });
+    m_evictors.insert(it, Evictor{ priority, std::move(fn) });
+}
+
+void MemoryBudget::drawImGui() {
+    if (!ImGui::Begin("gpu memory")) {
+        ImGui::End();
+        return;
+    }
+
+    if (!m_extBudget) ImGui::TextUnformatted("VK_EXT_memory_budget not supported, budgets are estimates");
+
+    char overlay[64];
+    for (uint32_t heap = 0; heap < m_props.memoryHeapCount; heap++) {
+        auto& b = m_budgets[heap];
+        bool deviceLocal = m_props.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+        ImGui::Text("heap %u (%s, %.0f MB)", heap, deviceLocal ? "device local" : "host", m_props.memoryHeaps[heap].size / MB);
+        snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB", b.usage / MB, b.budget / MB);
+        ImGui::ProgressBar(b.budget ? (float)b.usage / b.budget : 0.0f, ImVec2(-1.0f, 0.0f), overlay);
+        ImGui::Text("  vma blocks %.1f MB, %u allocations %.1f MB",
+            b.statistics.blockBytes / MB, b.statistics.allocationCount, b.statistics.allocationBytes / MB);
+    }
+
+    ImGui::Separator();
+    for (size_t i = 0; i < (size_t)MemoryCategory::Count; i++) {
+        auto category = (MemoryCategory)i;
+        ImGui::Text("%-16s %8.1f MB", vkutil::memory_category_name(category), vkutil::tracked_bytes(category) / MB);
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "vk_common.h"
+
+// what an allocation is for, shown per category in the memory panel
+enum class MemoryCategory : uint8_t {
+    Other,
+    RenderTargets,
+    Buffers, // long lived vertex, index, uniform and storage data
+    FrameData, // per frame rings and staging
+    Descriptors,
+    Count,
+};
+
+namespace vkutil {
+    // tags the allocation with its category (as vma user data) and adds its size to the category's total,
+    // untrack reads the tag back, so only the allocation is needed to remove it. both are thread safe
+    void track_allocation(VmaAllocator allocator, VmaAllocation allocation, MemoryCategory category);
+    void untrack_allocation(VmaAllocator allocator, VmaAllocation allocation);
+    VkDeviceSize tracked_bytes(MemoryCategory category);
+    const char* memory_category_name(MemoryCategory category);
+}
+
+constexpr float MEMORY_EVICT_THRESHOLD = 0.9f; // fraction of a heap's budget that triggers eviction
+constexpr float MEMORY_EVICT_TARGET = 0.8f; // eviction asks for enough to get back under this
+
+// per heap usage against the budget the os gives the process (VK_EXT_memory_budget, or vma's estimate
+// from the heap size without it), polled every frame so pressure shows up before allocations fail
+struct MemoryBudget {
+    // asked to free bytes from heap, returns how much it released or has queued for release.
+    // lower priorities are asked first
+    using EvictFn = std::function<VkDeviceSize(uint32_t heap, VkDeviceSize bytes)>;
+
+    void init(VkPhysicalDevice physDev, VmaAllocator allocator, bool extBudget);
+
+    // refreshes the budgets and runs the eviction callbacks for any heap past MEMORY_EVICT_THRESHOLD.
+    // call once a frame, vma only re-queries the driver when the frame index changes
+    void update(uint64_t frameNum);
+
+    void addEvictionCallback(int priority, EvictFn&& fn);
+
+    const VmaBudget& budget(uint32_t heap) const { return m_budgets[heap]; }
+    uint32_t heapCount() const { return m_props.memoryHeapCount; }
+
+    void drawImGui();
+
+private:
+    struct Evictor {
+        int priority;
+        EvictFn fn;
+    };
+
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties m_props = {};
+    VmaBudget m_budgets[VK_MAX_MEMORY_HEAPS] = {};
+    std::vector<Evictor> m_evictors; // sorted by priority
+    uint32_t m_overBudget = 0; // bit per heap, so each episode is only reported once
+    bool m_extBudget = false;
+};
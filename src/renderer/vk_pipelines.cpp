@@ -1,8 +1,13 @@
 #include "vk_pipelines.h"
 #include "vk_initialisers.h"
 #include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <atomic>
 
-bool vkutil::load_shader_module(const char *filePath, VkDevice device, VkShaderModule *out) {
+bool vkutil::load_shader_module(const char *filePath, VkDevice device, VkShaderModule *out, ShaderReflection* reflection) {
     
     std::ifstream file(filePath, std::ios::ate | std::ios::binary);
     if (!file.is_open()) return false;
@@ -14,14 +19,524 @@ bool vkutil::load_shader_module(const char *filePath, VkDevice device, VkShaderM
     file.read((char*)buffer.data(), fSize);
     file.close();
 
+    return create_shader_module(buffer, device, out, reflection);
+}
+
+bool vkutil::create_shader_module(std::span<const uint32_t> code, VkDevice device, VkShaderModule* out, ShaderReflection* reflection) {
+    if (reflection && !reflect_spirv(code, *reflection)) return false;
+
     VkShaderModuleCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     info.pNext = nullptr;
-    info.codeSize = buffer.size() * sizeof(uint32_t); // size in bytes
-    info.pCode = buffer.data();
+    info.codeSize = code.size() * sizeof(uint32_t); // size in bytes
+    info.pCode = code.data();
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(device, &info, nullptr, &shaderModule) != VK_SUCCESS) return false;
     *out = shaderModule;
     return true;
 }
+
+void PipelineCache::init(VkDevice device, VkPhysicalDevice physDev, const char* path) {
+    m_path = path;
+    vkGetPhysicalDeviceProperties(physDev, &m_props);
+
+    std::vector<char> data;
+    std::ifstream file(m_path, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+        data.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(data.data(), data.size());
+        file.close();
+
+        if (!validate(data)) {
+            fmt::print("pipeline cache {} is from another device or driver, ignoring it\n", m_path);
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.pNext = nullptr;
+    info.initialDataSize = data.size();
+    info.pInitialData = data.empty() ? nullptr : data.data();
+    VK_CHECK(vkCreatePipelineCache(device, &info, nullptr, &m_cache));
+}
+
+void PipelineCache::destroy(VkDevice device) {
+    vkDestroyPipelineCache(device, m_cache, nullptr);
+    m_cache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::save(VkDevice device) {
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, m_cache, &size, nullptr));
+    std::vector<char> data(size);
+    VK_CHECK(vkGetPipelineCacheData(device, m_cache, &size, data.data()));
+
+    std::string tmpPath = m_path + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        fmt::print("error writing pipeline cache {}\n", tmpPath);
+        return;
+    }
+    file.write(data.data(), size);
+    file.close();
+    if (!file) {
+        fmt::print("error writing pipeline cache {}\n", tmpPath);
+        return;
+    }
+
+    std::error_code err;
+    std::filesystem::rename(tmpPath, m_path, err);
+    if (err) fmt::print("error replacing pipeline cache {}: {}\n", m_path, err.message());
+}
+
+bool PipelineCache::validate(const std::vector<char>& data) const {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) return false;
+    memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header)
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == m_props.vendorID
+        && header.deviceID == m_props.deviceID
+        && memcmp(header.pipelineCacheUUID, m_props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+namespace {
+    using vkutil::hash_bytes;
+    using vkutil::hash_value;
+    using vkutil::HASH_SEED;
+
+    uint64_t hash_string(uint64_t h, const char* str) {
+        return hash_bytes(h, str, strlen(str) + 1);
+    }
+
+    VkPipelineShaderStageCreateInfo shader_stage_info(VkShaderStageFlagBits stage, VkShaderModule module, const char* entry) {
+        VkPipelineShaderStageCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        info.pNext = nullptr;
+        info.stage = stage;
+        info.module = module;
+        info.pName = entry;
+        return info;
+    }
+} // namespace
+
+void PipelineBuilder::clear() {
+    m_stages.clear();
+    m_bindings.clear();
+    m_attributes.clear();
+    m_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    m_polygonMode = VK_POLYGON_MODE_FILL;
+    m_cullMode = VK_CULL_MODE_NONE;
+    m_frontFace = VK_FRONT_FACE_CLOCKWISE;
+    m_samples = VK_SAMPLE_COUNT_1_BIT;
+    m_colorFormats.clear();
+    m_depthFormat = VK_FORMAT_UNDEFINED;
+    m_layout = VK_NULL_HANDLE;
+    m_flags = 0;
+    disableBlending();
+    disableDepthTest();
+}
+
+PipelineBuilder& PipelineBuilder::addShaderStage(VkShaderStageFlagBits stage, VkShaderModule module, const char* entry) {
+    m_stages.push_back({ stage, module, entry });
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setShaders(VkShaderModule vert, VkShaderModule frag) {
+    m_stages.clear();
+    addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vert);
+    return addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, frag);
+}
+
+PipelineBuilder& PipelineBuilder::setVertexInput(std::span<const VkVertexInputBindingDescription> bindings,
+    std::span<const VkVertexInputAttributeDescription> attributes) {
+    m_bindings.assign(bindings.begin(), bindings.end());
+    m_attributes.assign(attributes.begin(), attributes.end());
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setInputTopology(VkPrimitiveTopology topology) {
+    m_topology = topology;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setPolygonMode(VkPolygonMode mode) {
+    m_polygonMode = mode;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setCullMode(VkCullModeFlags cullMode, VkFrontFace frontFace) {
+    m_cullMode = cullMode;
+    m_frontFace = frontFace;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setMultisamplingNone() {
+    m_samples = VK_SAMPLE_COUNT_1_BIT;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::disableBlending() {
+    m_blend = {};
+    m_blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    m_blend.blendEnable = VK_FALSE;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::enableBlendingAdditive() {
+    m_blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    m_blend.blendEnable = VK_TRUE;
+    m_blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    m_blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    m_blend.colorBlendOp = VK_BLEND_OP_ADD;
+    m_blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    m_blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    m_blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::enableBlendingAlphaBlend() {
+    m_blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    m_blend.blendEnable = VK_TRUE;
+    m_blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    m_blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    m_blend.colorBlendOp = VK_BLEND_OP_ADD;
+    m_blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    m_blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    m_blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setColorAttachmentFormat(VkFormat format) {
+    m_colorFormats.assign(1, format);
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setColorAttachmentFormats(std::span<const VkFormat> formats) {
+    m_colorFormats.assign(formats.begin(), formats.end());
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setDepthFormat(VkFormat format) {
+    m_depthFormat = format;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::disableDepthTest() {
+    m_depthTest = false;
+    m_depthWrite = false;
+    m_depthOp = VK_COMPARE_OP_NEVER;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::enableDepthTest(bool depthWrite, VkCompareOp op) {
+    m_depthTest = true;
+    m_depthWrite = depthWrite;
+    m_depthOp = op;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setLayout(VkPipelineLayout layout) {
+    m_layout = layout;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::setFlags(VkPipelineCreateFlags flags) {
+    m_flags = flags;
+    return *this;
+}
+
+uint64_t PipelineBuilder::hash() const {
+    uint64_t h = hash_value(HASH_SEED, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    for (auto& stage : m_stages) {
+        h = hash_value(h, stage.stage);
+        h = hash_value(h, stage.module);
+        h = hash_string(h, stage.entry);
+    }
+    for (auto& binding : m_bindings) h = hash_value(h, binding);
+    for (auto& attribute : m_attributes) h = hash_value(h, attribute);
+    h = hash_value(h, m_topology);
+    h = hash_value(h, m_polygonMode);
+    h = hash_value(h, m_cullMode);
+    h = hash_value(h, m_frontFace);
+    h = hash_value(h, m_samples);
+    h = hash_value(h, m_blend);
+    h = hash_value(h, m_colorFormats.size());
+    for (auto format : m_colorFormats) h = hash_value(h, format);
+    h = hash_value(h, m_depthFormat);
+    h = hash_value(h, m_depthTest);
+    h = hash_value(h, m_depthWrite);
+    h = hash_value(h, m_depthOp);
+    h = hash_value(h, m_layout);
+    h = hash_value(h, m_flags);
+    return h;
+}
+
+VkPipeline PipelineBuilder::build(VkDevice device, VkPipelineCache cache) const {
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    for (auto& stage : m_stages) stages.push_back(shader_stage_info(stage.stage, stage.module, stage.entry));
+
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInput.vertexBindingDescriptionCount = (uint32_t)m_bindings.size();
+    vertexInput.pVertexBindingDescriptions = m_bindings.data();
+    vertexInput.vertexAttributeDescriptionCount = (uint32_t)m_attributes.size();
+    vertexInput.pVertexAttributeDescriptions = m_attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = m_topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = m_polygonMode;
+    rasterizer.cullMode = m_cullMode;
+    rasterizer.frontFace = m_frontFace;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = m_samples;
+    multisampling.minSampleShading = 1.0f;
+
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(m_colorFormats.size(), m_blend);
+    VkPipelineColorBlendStateCreateInfo blend = {};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.logicOpEnable = VK_FALSE;
+    blend.logicOp = VK_LOGIC_OP_COPY;
+    blend.attachmentCount = (uint32_t)blendAttachments.size();
+    blend.pAttachments = blendAttachments.data();
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = m_depthTest;
+    depthStencil.depthWriteEnable = m_depthWrite;
+    depthStencil.depthCompareOp = m_depthOp;
+    depthStencil.minDepthBounds = 0.0f;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates = dynamicStates;
+
+    // dynamic rendering, attachment formats replace the render pass
+    VkPipelineRenderingCreateInfo rendering = {};
+    rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering.colorAttachmentCount = (uint32_t)m_colorFormats.size();
+    rendering.pColorAttachmentFormats = m_colorFormats.data();
+    rendering.depthAttachmentFormat = m_depthFormat;
+
+    VkGraphicsPipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.pNext = &rendering;
+    info.flags = m_flags;
+    info.stageCount = (uint32_t)stages.size();
+    info.pStages = stages.data();
+    info.pVertexInputState = &vertexInput;
+    info.pInputAssemblyState = &inputAssembly;
+    info.pViewportState = &viewport;
+    info.pRasterizationState = &rasterizer;
+    info.pMultisampleState = &multisampling;
+    info.pColorBlendState = &blend;
+    info.pDepthStencilState = &depthStencil;
+    info.pDynamicState = &dynamic;
+    info.layout = m_layout;
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateGraphicsPipelines(device, cache, 1, &info, nullptr, &pipeline));
+    return pipeline;
+}
+
+ComputePipelineBuilder& ComputePipelineBuilder::setShader(VkShaderModule module, const char* entry) {
+    m_module = module;
+    m_entry = entry;
+    return *this;
+}
+
+ComputePipelineBuilder& ComputePipelineBuilder::setLayout(VkPipelineLayout layout) {
+    m_layout = layout;
+    return *this;
+}
+
+ComputePipelineBuilder& ComputePipelineBuilder::setFlags(VkPipelineCreateFlags flags) {
+    m_flags = flags;
+    return *this;
+}
+
+ComputePipelineBuilder& ComputePipelineBuilder::setSpecialization(uint32_t id, uint32_t value) {
+    for (size_t i = 0; i < m_specEntries.size(); i++) {
+        if (m_specEntries[i].constantID == id) {
+            m_specData[i] = value;
+            return *this;
+        }
+    }
+    m_specEntries.push_back({ id, (uint32_t)(m_specData.size() * sizeof(uint32_t)), sizeof(uint32_t) });
+    m_specData.push_back(value);
+    return *this;
+}
+
+uint64_t ComputePipelineBuilder::hash() const {
+    uint64_t h = hash_value(HASH_SEED, VK_PIPELINE_BIND_POINT_COMPUTE);
+    h = hash_value(h, m_module);
+    h = hash_string(h, m_entry);
+    h = hash_value(h, m_layout);
+    h = hash_value(h, m_flags);
+    // order the constants were set in doesn't change the pipeline, so it mustn't change the hash
+    uint64_t spec = 0;
+    for (size_t i = 0; i < m_specEntries.size(); i++) {
+        spec += hash_value(hash_value(HASH_SEED, m_specEntries[i].constantID), m_specData[i]);
+    }
+    h = hash_value(h, spec);
+    return h;
+}
+
+VkPipeline ComputePipelineBuilder::build(VkDevice device, VkPipelineCache cache) const {
+    VkSpecializationInfo spec = {};
+    spec.mapEntryCount = (uint32_t)m_specEntries.size();
+    spec.pMapEntries = m_specEntries.data();
+    spec.dataSize = m_specData.size() * sizeof(uint32_t);
+    spec.pData = m_specData.data();
+
+    VkComputePipelineCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.pNext = nullptr;
+    info.flags = m_flags;
+    info.layout = m_layout;
+    info.stage = shader_stage_info(VK_SHADER_STAGE_COMPUTE_BIT, m_module, m_entry);
+    info.stage.pSpecializationInfo = m_specEntries.empty() ? nullptr : &spec;
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateComputePipelines(device, cache, 1, &info, nullptr, &pipeline));
+    return pipeline;
+}
+
+void PipelineRegistry::init(PipelineCache* cache, const ShaderArchive* archive) {
+    m_cache = cache;
+    m_archive = archive;
+}
+
+void PipelineRegistry::destroy(VkDevice device) {
+    for (auto& [hash, pipeline] : m_pipelines) vkDestroyPipeline(device, pipeline, nullptr);
+    for (auto& [path, module] : m_shaders) vkDestroyShaderModule(device, module, nullptr);
+    m_pipelines.clear();
+    m_shaders.clear();
+    m_reflections.clear();
+}
+
+VkShaderModule PipelineRegistry::shader(VkDevice device, const char* path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_shaders.find(path);
+    if (it != m_shaders.end()) return it->second;
+
+    // compiled into the binary, then the mapped archive, and only then a loose file relative to the working dir
+    std::span<const uint32_t> code = vkutil::embedded_shader(path);
+    if (code.empty() && m_archive) code = m_archive->find(path);
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    ShaderReflection reflection;
+    bool loaded = code.empty()
+        ? vkutil::load_shader_module(path, device, &module, &reflection)
+        : vkutil::create_shader_module(code, device, &module, &reflection);
+    if (!loaded) {
+        fmt::print("error building shader {}\n", path);
+        abort();
+    }
+    m_shaders.emplace(path, module);
+    m_reflections.emplace(module, std::move(reflection));
+    return module;
+}
+
+const ShaderReflection& PipelineRegistry::reflection(VkShaderModule module) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reflections.at(module);
+}
+
+VkPipeline PipelineRegistry::get(VkDevice device, const PipelineBuilder& builder, bool* cached) {
+    return getOrBuild(device, builder, cached);
+}
+
+VkPipeline PipelineRegistry::get(VkDevice device, const ComputePipelineBuilder& builder, bool* cached) {
+    return getOrBuild(device, builder, cached);
+}
+
+void PipelineRegistry::release(VkDevice device, const ComputePipelineBuilder& builder) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pipelines.find(builder.hash());
+    if (it == m_pipelines.end()) return;
+    vkDestroyPipeline(device, it->second, nullptr);
+    m_pipelines.erase(it);
+}
+
+template <typename Builder> VkPipeline PipelineRegistry::getOrBuild(VkDevice device, const Builder& builder, bool* cached) {
+    uint64_t hash = builder.hash();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pipelines.find(hash);
+        if (cached) *cached = it != m_pipelines.end();
+        if (it != m_pipelines.end()) return it->second;
+    }
+
+    // compile outside the lock so other threads can look up or build at the same time
+    VkPipeline pipeline = builder.build(device, m_cache ? m_cache->cache() : VK_NULL_HANDLE);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto [it, inserted] = m_pipelines.emplace(hash, pipeline);
+    if (!inserted) vkDestroyPipeline(device, pipeline, nullptr); // another thread built the same state first
+    return it->second;
+}
+
+void PipelineBatch::add(const char* name, const PipelineBuilder& builder, VkPipeline* out) {
+    m_jobs.push_back({ name, [builder](PipelineRegistry& registry, VkDevice device, bool& cached) {
+        return registry.getOrBuild(device, builder, &cached);
+    }, out });
+}
+
+void PipelineBatch::add(const char* name, const ComputePipelineBuilder& builder, VkPipeline* out) {
+    m_jobs.push_back({ name, [builder](PipelineRegistry& registry, VkDevice device, bool& cached) {
+        return registry.getOrBuild(device, builder, &cached);
+    }, out });
+}
+
+void PipelineRegistry::compile(VkDevice device, PipelineBatch& batch, uint32_t threadCount) {
+    if (batch.m_jobs.empty()) return;
+
+    if (threadCount == 0) threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = std::min(threadCount, (uint32_t)batch.m_jobs.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    // workers pull the next job until the batch runs dry, so slow pipelines don't hold up a fixed split
+    std::atomic<size_t> next = 0;
+    auto worker = [&]() {
+        for (size_t i = next++; i < batch.m_jobs.size(); i = next++) {
+            auto& job = batch.m_jobs[i];
+            auto jobStart = std::chrono::steady_clock::now();
+            *job.out = job.build(*this, device, job.cached);
+            job.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - jobStart).count();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < threadCount; i++) threads.emplace_back(worker);
+    worker(); // the calling thread works too
+    for (auto& thread : threads) thread.join();
+
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    fmt::print("compiled {} pipelines on {} threads in {:.2f}ms\n", batch.m_jobs.size(), threadCount, totalMs);
+    for (auto& job : batch.m_jobs) {
+        if (job.cached) fmt::print("  {}: already built\n", job.name);
+        else fmt::print("  {}: {:.2f}ms\n", job.name, job.ms);
+    }
+}
@@ -1,6 +1,166 @@
 #pragma once
 #include "vk_common.h"
+#include "vk_reflect.h"
+#include "vk_shaders.h"
+
+#include <mutex>
+#include <unordered_map>
 
 namespace vkutil {
-    bool load_shader_module(const char* filePath, VkDevice device, VkShaderModule* out);
-} // namespace vkutil
\ No newline at end of file
+    bool load_shader_module(const char* filePath, VkDevice device, VkShaderModule* out, ShaderReflection* reflection = nullptr);
+    // code is passed straight to the driver, so mapped or embedded spir-v is never copied
+    bool create_shader_module(std::span<const uint32_t> code, VkDevice device, VkShaderModule* out, ShaderReflection* reflection = nullptr);
+} // namespace vkutil
+
+// VkPipelineCache persisted between runs. the file is only used if its header matches this
+// device (vendor, device and cache uuid), otherwise compilation starts from an empty cache
+struct PipelineCache {
+    void init(VkDevice device, VkPhysicalDevice physDev, const char* path);
+    void destroy(VkDevice device);
+
+    // writes the cache to a temp file, then renames it over the old one, so a crash mid write never
+    // leaves a truncated cache behind
+    void save(VkDevice device);
+
+    VkPipelineCache cache() const { return m_cache; }
+
+private:
+    bool validate(const std::vector<char>& data) const;
+
+    std::string m_path;
+    VkPhysicalDeviceProperties m_props = {};
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+};
+
+// graphics pipeline state for dynamic rendering. viewport and scissor are always dynamic
+struct PipelineBuilder {
+    PipelineBuilder() { clear(); }
+    void clear();
+
+    PipelineBuilder& addShaderStage(VkShaderStageFlagBits stage, VkShaderModule module, const char* entry = "main");
+    PipelineBuilder& setShaders(VkShaderModule vert, VkShaderModule frag);
+    PipelineBuilder& setVertexInput(std::span<const VkVertexInputBindingDescription> bindings, std::span<const VkVertexInputAttributeDescription> attributes);
+    PipelineBuilder& setInputTopology(VkPrimitiveTopology topology);
+    PipelineBuilder& setPolygonMode(VkPolygonMode mode);
+    PipelineBuilder& setCullMode(VkCullModeFlags cullMode, VkFrontFace frontFace);
+    PipelineBuilder& setMultisamplingNone();
+    PipelineBuilder& disableBlending();
+    PipelineBuilder& enableBlendingAdditive();
+    PipelineBuilder& enableBlendingAlphaBlend();
+    PipelineBuilder& setColorAttachmentFormat(VkFormat format);
+    PipelineBuilder& setColorAttachmentFormats(std::span<const VkFormat> formats); // same blend state for every attachment
+    PipelineBuilder& setDepthFormat(VkFormat format);
+    PipelineBuilder& disableDepthTest();
+    PipelineBuilder& enableDepthTest(bool depthWrite, VkCompareOp op);
+    PipelineBuilder& setLayout(VkPipelineLayout layout);
+    PipelineBuilder& setFlags(VkPipelineCreateFlags flags);
+
+    // hash of everything build() reads
+    uint64_t hash() const;
+    VkPipeline build(VkDevice device, VkPipelineCache cache) const;
+
+private:
+    struct Stage {
+        VkShaderStageFlagBits stage;
+        VkShaderModule module;
+        const char* entry;
+    };
+
+    std::vector<Stage> m_stages;
+    std::vector<VkVertexInputBindingDescription> m_bindings;
+    std::vector<VkVertexInputAttributeDescription> m_attributes;
+    VkPrimitiveTopology m_topology;
+    VkPolygonMode m_polygonMode;
+    VkCullModeFlags m_cullMode;
+    VkFrontFace m_frontFace;
+    VkSampleCountFlagBits m_samples;
+    VkPipelineColorBlendAttachmentState m_blend;
+    std::vector<VkFormat> m_colorFormats;
+    VkFormat m_depthFormat;
+    bool m_depthTest, m_depthWrite;
+    VkCompareOp m_depthOp;
+    VkPipelineLayout m_layout;
+    VkPipelineCreateFlags m_flags;
+};
+
+struct ComputePipelineBuilder {
+    ComputePipelineBuilder& setShader(VkShaderModule module, const char* entry = "main");
+    ComputePipelineBuilder& setLayout(VkPipelineLayout layout);
+    ComputePipelineBuilder& setFlags(VkPipelineCreateFlags flags);
+    // overrides the spec constant with this id, every scalar spec constant (uint, int, float, bool) is 4 bytes.
+    // each distinct set of values is its own pipeline
+    ComputePipelineBuilder& setSpecialization(uint32_t id, uint32_t value);
+
+    uint64_t hash() const;
+    VkPipeline build(VkDevice device, VkPipelineCache cache) const;
+
+private:
+    VkShaderModule m_module = VK_NULL_HANDLE;
+    const char* m_entry = "main";
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+    VkPipelineCreateFlags m_flags = 0;
+    std::vector<VkSpecializationMapEntry> m_specEntries;
+    std::vector<uint32_t> m_specData;
+};
+
+// pipelines to compile together, see PipelineRegistry::compile
+struct PipelineBatch {
+    // out is written once the batch has compiled, name must outlive the compile (string literals)
+    void add(const char* name, const PipelineBuilder& builder, VkPipeline* out);
+    void add(const char* name, const ComputePipelineBuilder& builder, VkPipeline* out);
+
+    size_t size() const { return m_jobs.size(); }
+
+private:
+    friend struct PipelineRegistry;
+
+    struct Job {
+        const char* name;
+        std::function<VkPipeline(PipelineRegistry& registry, VkDevice device, bool& cached)> build;
+        VkPipeline* out;
+        double ms = 0.0;
+        bool cached = false;
+    };
+    std::vector<Job> m_jobs;
+};
+
+// every pipeline the renderer uses, keyed by the hash of its full state, so requests for state
+// that's already been built return the existing pipeline instead of compiling it again.
+// shader modules are owned here too and live as long as the registry, so a module handle in a
+// hash can never be reused for different code
+struct PipelineRegistry {
+    // archive must outlive the registry's shader() calls, modules don't reference it once created
+    void init(PipelineCache* cache, const ShaderArchive* archive = nullptr);
+    void destroy(VkDevice device);
+
+    // loads path once, later calls return the same module. embedded shaders are checked first, then the archive
+    VkShaderModule shader(VkDevice device, const char* path);
+    // what the module's entry point binds, parsed when shader() loaded it
+    const ShaderReflection& reflection(VkShaderModule module);
+
+    // cached is set if the state had already been built
+    VkPipeline get(VkDevice device, const PipelineBuilder& builder, bool* cached = nullptr);
+    VkPipeline get(VkDevice device, const ComputePipelineBuilder& builder, bool* cached = nullptr);
+
+    // destroys the pipeline built for this state, for throwaway ones like benchmark candidates.
+    // the gpu has to be done with it and nothing may still hold the handle
+    void release(VkDevice device, const ComputePipelineBuilder& builder);
+
+    // compiles the batch across threadCount worker threads (0 = one per core) sharing the pipeline cache,
+    // then prints each pipeline's compile time. blocks until every pipeline is built
+    void compile(VkDevice device, PipelineBatch& batch, uint32_t threadCount = 0);
+
+    size_t size() const { return m_pipelines.size(); }
+
+private:
+    friend struct PipelineBatch;
+
+    template <typename Builder> VkPipeline getOrBuild(VkDevice device, const Builder& builder, bool* cached = nullptr);
+
+    PipelineCache* m_cache = nullptr;
+    const ShaderArchive* m_archive = nullptr;
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, VkPipeline> m_pipelines;
+    std::unordered_map<std::string, VkShaderModule> m_shaders;
+    std::unordered_map<VkShaderModule, ShaderReflection> m_reflections;
+};
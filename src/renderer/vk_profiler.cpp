@@ -0,0 +1,119 @@
+#include "vk_profiler.h"
+#include "vk_initialisers.h"
+
+#include <imgui.h>
+#include <cstring>
+#include <cstdio>
+
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physDev, uint32_t queueFamily, uint32_t frameCount, const char* title) {
+    m_title = title;
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physDev, &props);
+    m_periodNs = props.limits.timestampPeriod;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physDev, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physDev, &familyCount, families.data());
+
+    // 0 valid bits means the queue can't write timestamps at all
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    m_supported = validBits != 0;
+    m_validMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+    if (!m_supported) return;
+
+    m_frames.resize(frameCount);
+    auto poolInfo = vkinit::query_pool_create_info(VK_QUERY_TYPE_TIMESTAMP, PROFILER_MAX_SCOPES * 2);
+    for (auto& frame : m_frames) {
+        VK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &frame.pool));
+    }
+}
+
+void GpuProfiler::destroy(VkDevice device) {
+    for (auto& frame : m_frames) {
+        vkDestroyQueryPool(device, frame.pool, nullptr);
+    }
+    m_frames.clear();
+    m_current = nullptr;
+}
+
+void GpuProfiler::beginFrame(VkDevice device, VkCommandBuffer cmd, uint32_t frameIndex) {
+    if (!m_supported) return;
+
+    Frame& frame = m_frames[frameIndex];
+
+    // read back what this slot recorded last time round, no wait flag so this never blocks
+    if (frame.scopeCount > 0) {
+        uint64_t ticks[PROFILER_MAX_SCOPES * 2];
+        auto res = vkGetQueryPoolResults(device, frame.pool, 0, frame.scopeCount * 2, sizeof(ticks), ticks,
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if (res == VK_SUCCESS) {
+            for (uint32_t i = 0; i < frame.scopeCount; i++) {
+                uint64_t begin = ticks[i * 2] & m_validMask;
+                uint64_t end = ticks[i * 2 + 1] & m_validMask;
+                float ms = float(double((end - begin) & m_validMask) * m_periodNs / 1000000.0);
+
+                auto& h = history(frame.names[i]);
+                h.last = ms;
+                h.samples[h.head] = ms;
+                h.head = (h.head + 1) % PROFILER_HISTORY;
+            }
+        }
+    }
+
+    vkCmdResetQueryPool(cmd, frame.pool, 0, PROFILER_MAX_SCOPES * 2);
+    frame.scopeCount = 0;
+    m_current = &frame;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer cmd, const char* name) {
+    if (!m_current || m_current->scopeCount >= PROFILER_MAX_SCOPES) return UINT32_MAX;
+
+    uint32_t scope = m_current->scopeCount++;
+    m_current->names[scope] = name;
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, m_current->pool, scope * 2);
+    return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer cmd, uint32_t scope) {
+    if (!m_current || scope == UINT32_MAX) return;
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, m_current->pool, scope * 2 + 1);
+}
+
+GpuProfiler::ScopeHistory& GpuProfiler::history(const char* name) {
+    for (auto& h : m_history)
+        if (std::strcmp(h.name, name) == 0)
+            return h;
+    return m_history.emplace_back(ScopeHistory{ .name = name });
+}
+
+void GpuProfiler::drawImGui() {
+    if (!ImGui::Begin(m_title)) {
+        ImGui::End();
+        return;
+    }
+
+    if (!m_supported) {
+        ImGui::TextUnformatted("timestamps not supported on this queue");
+        ImGui::End();
+        return;
+    }
+
+    for (const auto& h : m_history) {
+        float avg = 0.0f, peak = 0.0f;
+        for (float s : h.samples) {
+            avg += s;
+            peak = std::max(peak, s);
+        }
+        avg /= PROFILER_HISTORY;
+
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.3f ms (avg %.3f)", h.last, avg);
+
+        ImGui::PlotLines(h.name, h.samples, PROFILER_HISTORY, h.head, overlay, 0.0f, peak * 1.25f, ImVec2(0, 40));
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "vk_common.h"
+
+constexpr uint32_t PROFILER_MAX_SCOPES = 32;
+constexpr uint32_t PROFILER_HISTORY = 128;
+
+// gpu timestamp profiler, keeps one query pool per frame in flight.
+// a frame's results are read back when its slot comes round again, after the
+// renderer has already waited on it, so reading them never stalls
+struct GpuProfiler {
+    // title names the imgui window, one per profiled queue so their scopes don't mix. must outlive the profiler
+    void init(VkDevice device, VkPhysicalDevice physDev, uint32_t queueFamily, uint32_t frameCount, const char* title);
+    void destroy(VkDevice device);
+
+    // collects the results last recorded into this slot and resets its queries,
+    // call at the start of the frame's cmd buffer
+    void beginFrame(VkDevice device, VkCommandBuffer cmd, uint32_t frameIndex);
+
+    // name must outlive the frame (string literals)
+    uint32_t beginScope(VkCommandBuffer cmd, const char* name);
+    void endScope(VkCommandBuffer cmd, uint32_t scope);
+
+    void drawImGui();
+
+private:
+    struct Frame {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        uint32_t scopeCount = 0;
+        const char* names[PROFILER_MAX_SCOPES] = {};
+    };
+
+    struct ScopeHistory {
+        const char* name;
+        float samples[PROFILER_HISTORY] = {}; // ms, ring buffer
+        uint32_t head = 0;
+        float last = 0.0f;
+    };
+
+    ScopeHistory& history(const char* name);
+
+    std::vector<Frame> m_frames;
+    std::vector<ScopeHistory> m_history;
+    Frame* m_current = nullptr;
+    const char* m_title = "gpu profiler";
+    float m_periodNs = 0.0f; // ns per timestamp tick
+    uint64_t m_validMask = 0;
+    bool m_supported = false;
+};
+
+// records a scope for its lifetime
+struct GpuScope {
+    GpuScope(GpuProfiler& profiler, VkCommandBuffer cmd, const char* name)
+        : m_profiler(profiler), m_cmd(cmd), m_scope(profiler.beginScope(cmd, name)) {}
+    ~GpuScope() { m_profiler.endScope(m_cmd, m_scope); }
+
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+
+private:
+    GpuProfiler& m_profiler;
+    VkCommandBuffer m_cmd;
+    uint32_t m_scope;
+};
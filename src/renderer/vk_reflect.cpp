@@ -0,0 +1,350 @@
+#include "vk_reflect.h"
+
+namespace {
+    // the handful of spir-v enums the parser needs, from the unified spec
+    enum Op : uint32_t {
+        OpEntryPoint = 15,
+        OpExecutionMode = 16,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpConstantComposite = 44,
+        OpSpecConstant = 50,
+        OpSpecConstantComposite = 51,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+        OpExecutionModeId = 331,
+    };
+
+    enum Decoration : uint32_t {
+        DecorationSpecId = 1,
+        DecorationBlock = 2,
+        DecorationBufferBlock = 3,
+        DecorationArrayStride = 6,
+        DecorationBuiltIn = 11,
+        DecorationBinding = 33,
+        DecorationDescriptorSet = 34,
+        DecorationOffset = 35,
+    };
+
+    enum StorageClass : uint32_t {
+        StorageClassUniformConstant = 0,
+        StorageClassUniform = 2,
+        StorageClassPushConstant = 9,
+        StorageClassStorageBuffer = 12,
+    };
+
+    constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+    constexpr uint32_t ExecutionModeLocalSize = 17;
+    constexpr uint32_t ExecutionModeLocalSizeId = 38;
+    constexpr uint32_t BuiltInWorkgroupSize = 25;
+    constexpr uint32_t DimBuffer = 5;
+    constexpr uint32_t DimSubpassData = 6;
+
+    struct Id {
+        uint32_t opcode = 0;
+        uint32_t offset = 0; // word offset of the defining instruction
+        uint32_t set = UINT32_MAX, binding = UINT32_MAX;
+        uint32_t specId = UINT32_MAX;
+        uint32_t arrayStride = 0;
+        bool block = false, bufferBlock = false, workgroupSize = false;
+        std::vector<uint32_t> memberOffsets;
+    };
+
+    struct Module {
+        std::span<const uint32_t> code;
+        std::vector<Id> ids;
+
+        uint32_t word(const Id& id, uint32_t i) const { return code[id.offset + i]; }
+        const Id& type(uint32_t id) const { return ids[id]; }
+
+        // low word of a scalar constant, which covers every size and length the layouts care about
+        uint32_t constant(uint32_t id) const { return word(ids[id], 3); }
+
+        uint32_t size(uint32_t typeId) const {
+            const Id& t = ids[typeId];
+            switch (t.opcode) {
+            case OpTypeInt:
+            case OpTypeFloat: return word(t, 2) / 8;
+            case OpTypeVector:
+            case OpTypeMatrix: return size(word(t, 2)) * word(t, 3);
+            case OpTypeArray: return constant(word(t, 3)) * (t.arrayStride ? t.arrayStride : size(word(t, 2)));
+            case OpTypeStruct: {
+                uint32_t memberCount = (code[t.offset] >> 16) - 2;
+                uint32_t end = 0;
+                for (uint32_t i = 0; i < memberCount && i < t.memberOffsets.size(); i++) {
+                    end = std::max(end, t.memberOffsets[i] + size(word(t, 2 + i)));
+                }
+                return end;
+            }
+            default: return 0;
+            }
+        }
+    };
+
+    VkShaderStageFlagBits stage_from_model(uint32_t model) {
+        switch (model) {
+        case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+        case 5364: return VK_SHADER_STAGE_TASK_BIT_EXT;
+        case 5365: return VK_SHADER_STAGE_MESH_BIT_EXT;
+        default: return VK_SHADER_STAGE_ALL;
+        }
+    }
+
+    // descriptor type of a variable's pointee, with arrays already unwrapped
+    bool descriptor_type(const Module& m, const Id& type, uint32_t storageClass, VkDescriptorType& out) {
+        switch (type.opcode) {
+        case OpTypeSampler: out = VK_DESCRIPTOR_TYPE_SAMPLER; return true;
+        case OpTypeSampledImage: out = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; return true;
+        case OpTypeImage: {
+            uint32_t dim = m.word(type, 3);
+            uint32_t sampled = m.word(type, 7); // 1 = sampled, 2 = storage
+            if (dim == DimSubpassData) out = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            else if (dim == DimBuffer) out = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            else out = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            return true;
+        }
+        case OpTypeStruct:
+            if (storageClass == StorageClassStorageBuffer || type.bufferBlock) out = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            else out = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            return true;
+        default:
+            return false;
+        }
+    }
+} // namespace
+
+bool vkutil::reflect_spirv(std::span<const uint32_t> code, ShaderReflection& out) {
+    if (code.size() < 5 || code[0] != SPIRV_MAGIC) return false;
+
+    Module m = {};
+    m.code = code;
+    m.ids.resize(code[3]); // id bound
+
+    out = {};
+    uint32_t entryPoint = UINT32_MAX;
+    uint32_t localSizeIds[3] = { UINT32_MAX, UINT32_MAX, UINT32_MAX };
+
+    // first pass, record where every id is defined and what it's decorated with
+    for (uint32_t offset = 5; offset < code.size();) {
+        uint32_t opcode = code[offset] & 0xffff;
+        uint32_t wordCount = code[offset] >> 16;
+        if (wordCount == 0 || offset + wordCount > code.size()) return false;
+        const uint32_t* ops = &code[offset + 1];
+
+        switch (opcode) {
+        case OpEntryPoint:
+            if (entryPoint == UINT32_MAX) {
+                out.stage = stage_from_model(ops[0]);
+                entryPoint = ops[1];
+            }
+            break;
+        case OpExecutionMode:
+            if (ops[0] == entryPoint && ops[1] == ExecutionModeLocalSize) {
+                for (int i = 0; i < 3; i++) out.localSize[i] = ops[2 + i];
+            }
+            break;
+        case OpExecutionModeId:
+            if (ops[0] == entryPoint && ops[1] == ExecutionModeLocalSizeId) {
+                for (int i = 0; i < 3; i++) localSizeIds[i] = ops[2 + i];
+            }
+            break;
+        case OpDecorate: {
+            Id& target = m.ids[ops[0]];
+            switch (ops[1]) {
+            case DecorationSpecId: target.specId = ops[2]; break;
+            case DecorationBlock: target.block = true; break;
+            case DecorationBufferBlock: target.bufferBlock = true; break;
+            case DecorationArrayStride: target.arrayStride = ops[2]; break;
+            case DecorationBuiltIn: target.workgroupSize = ops[2] == BuiltInWorkgroupSize; break;
+            case DecorationBinding: target.binding = ops[2]; break;
+            case DecorationDescriptorSet: target.set = ops[2]; break;
+            }
+            break;
+        }
+        case OpMemberDecorate:
+            if (ops[2] == DecorationOffset) {
+                auto& offsets = m.ids[ops[0]].memberOffsets;
+                if (offsets.size() <= ops[1]) offsets.resize(ops[1] + 1);
+                offsets[ops[1]] = ops[3];
+            }
+            break;
+        case OpTypeInt: case OpTypeFloat: case OpTypeVector: case OpTypeMatrix:
+        case OpTypeImage: case OpTypeSampler: case OpTypeSampledImage:
+        case OpTypeArray: case OpTypeRuntimeArray: case OpTypeStruct: case OpTypePointer:
+            m.ids[ops[0]].opcode = opcode;
+            m.ids[ops[0]].offset = offset;
+            break;
+        case OpConstant: case OpSpecConstant: case OpConstantComposite: case OpSpecConstantComposite: case OpVariable:
+            m.ids[ops[1]].opcode = opcode;
+            m.ids[ops[1]].offset = offset;
+            break;
+        }
+        offset += wordCount;
+    }
+
+    // second pass over the ids, now every decoration is known
+    for (uint32_t id = 0; id < m.ids.size(); id++) {
+        const Id& v = m.ids[id];
+
+        // glslang style workgroup size, a composite decorated WorkgroupSize that overrides the execution mode
+        if (v.workgroupSize && (v.opcode == OpConstantComposite || v.opcode == OpSpecConstantComposite)) {
+            for (int i = 0; i < 3; i++) localSizeIds[i] = m.word(v, 3 + i);
+        }
+
+        if (v.opcode != OpVariable) continue;
+        uint32_t storageClass = m.word(v, 3);
+        const Id& pointer = m.type(m.word(v, 1));
+        const Id* type = &m.type(m.word(pointer, 3));
+
+        if (storageClass == StorageClassPushConstant) {
+            out.pushConstantSize = std::max(out.pushConstantSize, m.size(m.word(pointer, 3)));
+            continue;
+        }
+        if (storageClass != StorageClassUniformConstant && storageClass != StorageClassUniform && storageClass != StorageClassStorageBuffer) continue;
+        if (v.set == UINT32_MAX || v.binding == UINT32_MAX) continue;
+
+        ShaderReflection::Binding binding = { v.set, v.binding, VK_DESCRIPTOR_TYPE_MAX_ENUM, 1 };
+        if (type->opcode == OpTypeArray) {
+            binding.count = m.constant(m.word(*type, 3));
+            type = &m.type(m.word(*type, 2));
+        } else if (type->opcode == OpTypeRuntimeArray) {
+            binding.count = 0;
+            type = &m.type(m.word(*type, 2));
+        }
+        if (!descriptor_type(m, *type, storageClass, binding.type)) continue;
+        out.bindings.push_back(binding);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (localSizeIds[i] == UINT32_MAX) continue;
+        const Id& c = m.ids[localSizeIds[i]];
+        out.localSize[i] = m.word(c, 3);
+        out.localSizeSpecIds[i] = c.opcode == OpSpecConstant ? c.specId : UINT32_MAX;
+    }
+
+    std::sort(out.bindings.begin(), out.bindings.end(), [](auto& a, auto& b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+    return true;
+}
+
+void LayoutCache::destroy(VkDevice device) {
+    for (auto& [hash, layout] : m_pipelineLayouts) vkDestroyPipelineLayout(device, layout, nullptr);
+    for (auto& [hash, layout] : m_setLayouts) vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    m_pipelineLayouts.clear();
+    m_setLayouts.clear();
+}
+
+VkDescriptorSetLayout LayoutCache::setLayout(VkDevice device, std::span<const VkDescriptorSetLayoutBinding> bindings, VkDescriptorSetLayoutCreateFlags flags) {
+    uint64_t hash = vkutil::hash_value(vkutil::HASH_SEED, flags);
+    for (auto& b : bindings) {
+        hash = vkutil::hash_value(hash, b.binding);
+        hash = vkutil::hash_value(hash, b.descriptorType);
+        hash = vkutil::hash_value(hash, b.descriptorCount);
+        hash = vkutil::hash_value(hash, b.stageFlags);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_setLayouts.find(hash);
+    if (it != m_setLayouts.end()) return it->second;
+
+    VkDescriptorSetLayoutCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    info.pNext = nullptr;
+    info.flags = flags;
+    info.bindingCount = (uint32_t)bindings.size();
+    info.pBindings = bindings.data();
+
+    VkDescriptorSetLayout layout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &info, nullptr, &layout));
+    m_setLayouts.emplace(hash, layout);
+    return layout;
+}
+
+VkPipelineLayout LayoutCache::pipelineLayout(VkDevice device, std::initializer_list<const ShaderReflection*> stages, VkDescriptorSetLayoutCreateFlags setFlags) {
+    // merge every stage's bindings per set, a binding used by several stages gets all of them
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+    std::vector<bool> bindless;
+    VkPushConstantRange pushConstants = {};
+    for (auto stage : stages) {
+        for (auto& b : stage->bindings) {
+            if (sets.size() <= b.set) {
+                sets.resize(b.set + 1);
+                bindless.resize(b.set + 1);
+            }
+            bindless[b.set] = bindless[b.set] || b.count == 0;
+
+            auto& set = sets[b.set];
+            auto it = std::find_if(set.begin(), set.end(), [&](auto& existing) { return existing.binding == b.binding; });
+            if (it != set.end()) {
+                it->stageFlags |= stage->stage;
+                continue;
+            }
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.binding = b.binding;
+            binding.descriptorType = b.type;
+            binding.descriptorCount = b.count;
+            binding.stageFlags = stage->stage;
+            set.push_back(binding);
+        }
+        if (stage->pushConstantSize) {
+            pushConstants.stageFlags |= stage->stage;
+            pushConstants.size = std::max(pushConstants.size, stage->pushConstantSize);
+        }
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(sets.size());
+    for (size_t i = 0; i < sets.size(); i++) {
+        std::sort(sets[i].begin(), sets[i].end(), [](auto& a, auto& b) { return a.binding < b.binding; });
+        if (bindless[i] && m_bindlessLayout) setLayouts[i] = m_bindlessLayout;
+        else setLayouts[i] = setLayout(device, sets[i], setFlags); // gaps in the set numbers get an empty layout
+    }
+
+    if (!pushConstants.size) return pipelineLayout(device, setLayouts, {});
+    return pipelineLayout(device, setLayouts, { &pushConstants, 1 });
+}
+
+VkPipelineLayout LayoutCache::pipelineLayout(VkDevice device, std::span<const VkDescriptorSetLayout> setLayouts, std::span<const VkPushConstantRange> pushConstants) {
+    uint64_t hash = vkutil::HASH_SEED;
+    for (auto& range : pushConstants) {
+        if (range.offset + range.size > vkutil::PUSH_CONSTANT_MIN_SIZE) {
+            fmt::print("warning: push constants end at byte {}, past the {} every device supports\n", range.offset + range.size, vkutil::PUSH_CONSTANT_MIN_SIZE);
+        }
+        hash = vkutil::hash_value(hash, range);
+    }
+    hash = vkutil::hash_value(hash, (uint32_t)pushConstants.size()); // keeps ranges and set layouts from aliasing
+    for (auto layout : setLayouts) hash = vkutil::hash_value(hash, layout);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pipelineLayouts.find(hash);
+    if (it != m_pipelineLayouts.end()) return it->second;
+
+    VkPipelineLayoutCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    info.pNext = nullptr;
+    info.setLayoutCount = (uint32_t)setLayouts.size();
+    info.pSetLayouts = setLayouts.data();
+    info.pushConstantRangeCount = (uint32_t)pushConstants.size();
+    info.pPushConstantRanges = pushConstants.data();
+
+    VkPipelineLayout layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &info, nullptr, &layout));
+    m_pipelineLayouts.emplace(hash, layout);
+    return layout;
+}
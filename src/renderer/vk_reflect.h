@@ -0,0 +1,50 @@
+#pragma once
+#include "vk_common.h"
+
+#include <mutex>
+#include <unordered_map>
+
+// what a spir-v module's first entry point expects from its pipeline layout
+struct ShaderReflection {
+    struct Binding {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count; // 0 = runtime array (bindless)
+    };
+
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+    std::vector<Binding> bindings;
+    uint32_t pushConstantSize = 0;
+
+    // compute only. a dimension set through a spec constant has its id here, UINT32_MAX otherwise
+    uint32_t localSize[3] = { 1, 1, 1 };
+    uint32_t localSizeSpecIds[3] = { UINT32_MAX, UINT32_MAX, UINT32_MAX };
+};
+
+namespace vkutil {
+    // minimal parser, only reads the decorations, types and variables layouts are built from
+    bool reflect_spirv(std::span<const uint32_t> code, ShaderReflection& out);
+}
+
+// set and pipeline layouts built from reflection, deduplicated so shaders with the same interface
+// share the same VkDescriptorSetLayout (and so sets allocated for one pipeline work with the others)
+struct LayoutCache {
+    void destroy(VkDevice device);
+
+    // a set whose bindings include a runtime array is the bindless set, and uses this layout instead of its own
+    void setBindlessLayout(VkDescriptorSetLayout layout) { m_bindlessLayout = layout; }
+
+    VkDescriptorSetLayout setLayout(VkDevice device, std::span<const VkDescriptorSetLayoutBinding> bindings, VkDescriptorSetLayoutCreateFlags flags = 0);
+
+    // merges the stages' bindings and push constants into one layout
+    VkPipelineLayout pipelineLayout(VkDevice device, std::initializer_list<const ShaderReflection*> stages, VkDescriptorSetLayoutCreateFlags setFlags = 0);
+    // for layouts built by hand, deduplicated the same way
+    VkPipelineLayout pipelineLayout(VkDevice device, std::span<const VkDescriptorSetLayout> setLayouts, std::span<const VkPushConstantRange> pushConstants);
+
+private:
+    std::mutex m_mutex;
+    VkDescriptorSetLayout m_bindlessLayout = VK_NULL_HANDLE;
+    std::unordered_map<uint64_t, VkDescriptorSetLayout> m_setLayouts;
+    std::unordered_map<uint64_t, VkPipelineLayout> m_pipelineLayouts;
+};
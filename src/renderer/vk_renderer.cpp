@@ -13,12 +13,15 @@
 
 void Renderer::init() {
 
-    glfwGetWindowSize(_wnd, (int*)&_wndExtent.width, (int*)&_wndExtent.height);
+    // headless extent is set by the caller
+    if (!_headless) glfwGetWindowSize(_wnd, (int*)&_wndExtent.width, (int*)&_wndExtent.height);
     
     init_vk();
     init_swapchain();
     init_cmds();
     init_sync();
+    init_frames();
+    init_profilers();
     init_descriptors();
     init_pipelines();
     init_imgui();
@@ -30,19 +33,20 @@ void Renderer::cleanup() {
     if (_isInitialised) {
         vkDeviceWaitIdle(_dev);
 
-        for (int i = 0; i < FRAME_OVERLAP; i++) {
-			vkDestroyCommandPool(_dev, _frames[i]._cmdPool, nullptr);
-            vkDestroyFence(_dev, _frames[i]._renderFence, nullptr);
-            vkDestroySemaphore(_dev, _frames[i]._renderSemaphore, nullptr);
-            vkDestroySemaphore(_dev ,_frames[i]._swapchainSemaphore, nullptr);
-
-            _frames[i]._deletionQueue.flush();
-		}
-
+        destroy_frames();
+        _profiler.destroy(_dev);
+        _computeProfiler.destroy(_dev);
+        _retireQueue.flush();
+
+        // before the primary queue, which destroys the allocator the headless imgs came from
+        if (_headless) {
+            destroy_headless_targets();
+        } else {
+            destroy_swapchain();
+            vkDestroySurfaceKHR(_instance, _surface, nullptr);
+        }
         _primaryDeletionQueue.flush();
 
-        destroy_swapchain();
-        vkDestroySurfaceKHR(_instance, _surface, nullptr);
         vkDestroyDevice(_dev, nullptr);
         vkb::destroy_debug_utils_messenger(_instance, _dbgMsgr);
         vkDestroyInstance(_instance, nullptr);
@@ -52,10 +56,42 @@ void Renderer::cleanup() {
 void Renderer::render() {
     
     ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (_headless) {
+        // no platform backend, so feed imgui the display size and a fixed timestep
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2((float)_swapchainExtent.width, (float)_swapchainExtent.height);
+        io.DeltaTime = 1.0f / 60.0f;
+    } else {
+        ImGui_ImplGlfw_NewFrame();
+    }
     ImGui::NewFrame();
 
-    ImGui::ShowDemoWindow();
+    _profiler.drawImGui();
+    if (_computeQueueFamily != _graphicsQueueFamily) _computeProfiler.drawImGui();
+    _memory.drawImGui();
+
+    if (ImGui::Begin("renderer")) {
+        int frameOverlap = (int)_frameOverlap;
+        if (ImGui::SliderInt("frames in flight", &frameOverlap, 1, (int)MAX_FRAME_OVERLAP))
+            set_frame_overlap((uint32_t)frameOverlap);
+
+        ImGui::BeginDisabled(_computeQueueFamily == _graphicsQueueFamily);
+        ImGui::Checkbox("async compute", &_asyncCompute);
+        ImGui::EndDisabled();
+
+        ImGui::Checkbox("gradient grid", &_gradientGrid);
+        ImGui::Text("gradient workgroup %ux%u", _gradientGroupSize.width, _gradientGroupSize.height);
+
+        bool autoDefrag = _defrag.automatic();
+        if (ImGui::Checkbox("auto defragment", &autoDefrag)) _defrag.setAutomatic(autoDefrag);
+        ImGui::SameLine();
+        if (ImGui::Button("defragment")) _defrag.request();
+        auto& defrag = _defrag.stats();
+        ImGui::Text("defrag %zu registered, %u runs, %llu moves, %.1f MB freed%s", _defrag.registered(), defrag.runs,
+            (unsigned long long)defrag.moves, defrag.bytesFreed / (1024.0f * 1024.0f), _defrag.running() ? " (running)" : "");
+    }
+    ImGui::End();
+
     ImGui::Render();
 
     draw();
@@ -63,78 +99,191 @@ void Renderer::render() {
 
 void Renderer::draw() {
     
-    // wait for gpu to finish rendering last frame, 1sec timeout
-    VK_CHECK(vkWaitForFences(_dev, 1, &get_current_frame()._renderFence, true, 1000000000));
-    get_current_frame()._deletionQueue.flush();
+    // wait for gpu to finish the last submit that used this frame's resources, 1sec timeout
+    wait_timeline(get_current_frame()._timelineValue, 1000000000);
+    get_current_frame()._arena.reset();
+    _memory.update(_frameNum);
+    _defrag.update(_frameNum, _memory);
+    _frameRing.beginFrame((uint32_t)(_frameNum % _frameOverlap));
+    _retireQueue.collect(completed_timeline_value());
+
+    if (_resizeRequested) {
+        rebuild_swapchain();
+        if (_resizeRequested) return; // minimised
+    }
 
-    // request img from swapchain
+    // request img from swapchain, or cycle through the offscreen ring when headless
     uint32_t swapchainImageIndex;
-    auto e = vkAcquireNextImageKHR(_dev, _swapchain, 1000000000, get_current_frame()._swapchainSemaphore, nullptr, &swapchainImageIndex);
-	if (e == VK_ERROR_OUT_OF_DATE_KHR) {
-		rebuild_swapchain();
-		return;
-	}
+    if (_headless) {
+        swapchainImageIndex = (uint32_t)(_frameNum % _swapchainImgs.size());
+    } else {
+        auto e = vkAcquireNextImageKHR(_dev, _swapchain, 1000000000, get_current_frame()._swapchainSemaphore, nullptr, &swapchainImageIndex);
+        if (e == VK_ERROR_OUT_OF_DATE_KHR) {
+            // nothing was signalled, so the frame can just be skipped
+            _resizeRequested = true;
+            return;
+        }
+        if (e == VK_SUBOPTIMAL_KHR) _resizeRequested = true; // still presentable, rebuild next frame
+        else VK_CHECK(e);
+    }
 
-    // reset fence and cmd buffer
-    VK_CHECK(vkResetFences(_dev, 1, &get_current_frame()._renderFence));
+	auto cmdBeginInfo = vkinit::cmd_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    uint32_t frameIndex = (uint32_t)(_frameNum % _frameOverlap);
+
+    // the draw img can be bigger than the swapchain after a shrink, only the overlap is rendered
+    _drawImgCurrent = (uint32_t)(_frameNum % _drawImgCount);
+    auto& drawImg = draw_img();
+    _drawExtent.width = std::min(drawImg.extent.width, _swapchainExtent.width);
+	_drawExtent.height = std::min(drawImg.extent.height, _swapchainExtent.height);
+
+    // async compute: the background pass runs on the compute queue and hands the draw img over to graphics.
+    // draw imgs alternate, so this frame's compute overlaps the previous frame's graphics work
+    bool asyncCompute = _asyncCompute && _computeQueueFamily != _graphicsQueueFamily;
+    uint64_t computeValue = 0;
+    if (asyncCompute) {
+        auto computeCmd = get_current_frame()._computeCmdBuf;
+        VK_CHECK(vkResetCommandBuffer(computeCmd, 0));
+        VK_CHECK(vkBeginCommandBuffer(computeCmd, &cmdBeginInfo));
+
+        _computeProfiler.beginFrame(_dev, computeCmd, frameIndex);
+
+        // contents are discarded, so no acquire is needed from graphics. the src stage chains onto the timeline wait below
+        vkutil::transition_img(computeCmd, drawImg.img, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+        {
+            GpuScope scope(_computeProfiler, computeCmd, "background");
+            draw_background(computeCmd);
+        }
+        vkutil::transfer_img_ownership(computeCmd, drawImg.img, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            _computeQueueFamily, _graphicsQueueFamily, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, true);
+
+        VK_CHECK(vkEndCommandBuffer(computeCmd));
+
+        // only wait for the graphics submit that last blitted this draw img, not the one still working on the other
+        auto computeCmdInfo = vkinit::cmd_buffer_submit_info(computeCmd);
+        auto computeWait = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, _timeline, _drawImgBlitValues[_drawImgCurrent]);
+        auto computeSignal = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _computeTimeline, ++_computeTimelineValue);
+        auto computeSubmit = vkinit::submit_info(&computeCmdInfo, &computeSignal, &computeWait);
+        VK_CHECK(vkQueueSubmit2(_computeQueue, 1, &computeSubmit, nullptr));
+
+        computeValue = _computeTimelineValue;
+    }
+
+    // reset cmd buffer
     VK_CHECK(vkResetCommandBuffer(get_current_frame()._cmdBuf, 0));
     auto cmd = get_current_frame()._cmdBuf; // alias command buffer to cmd
 
     // begin cmd buffer recording
-	auto cmdBeginInfo = vkinit::cmd_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
-    // setup draw img
-    _drawExtent.width = _drawImg.extent.width;
-	_drawExtent.height = _drawImg.extent.height;
-    vkutil::transition_img(cmd, _drawImg.img, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    _profiler.beginFrame(_dev, cmd, frameIndex);
+    uint32_t frameScope = _profiler.beginScope(cmd, "frame");
+
+    // submit whatever was uploaded since the last frame, and take ownership of what it released
+    _uploads.flush();
+    VkPipelineStageFlags2 uploadStages = VK_PIPELINE_STAGE_2_NONE;
+    uint64_t uploadValue = _uploads.recordAcquires(cmd, uploadStages);
+
+    if (asyncCompute) {
+        // acquire the draw img from the compute queue, matching the release above
+        vkutil::transfer_img_ownership(cmd, drawImg.img, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            _computeQueueFamily, _graphicsQueueFamily, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, false);
+    }
+
+    _graph.reset(get_current_frame()._arena);
+
+    // the draw img was last read by the previous frame's blit, or has just been acquired ready for the blit.
+    // the swapchain img's first use waits on the acquire semaphore, which is waited on at color attachment output
+    RGHandle drawImgHandle = asyncCompute
+        ? _graph.importImage(drawImg.img, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT)
+        : _graph.importImage(drawImg.img, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT);
+    RGHandle swapchainImg = _graph.importImage(_swapchainImgs[swapchainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
 
-    draw_background(cmd);
+    if (!asyncCompute) {
+        _graph.addPass("background", { { drawImgHandle, RGUsage::StorageWrite } }, [this](VkCommandBuffer cmd) {
+            draw_background(cmd);
+        });
+    }
 
-    // transition draw and swapchain imgs to transfer layouts
-	vkutil::transition_img(cmd, _drawImg.img, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-	vkutil::transition_img(cmd, _swapchainImgs[swapchainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    // copy draw img into swapchain img
+    _graph.addPass("blit", { { drawImgHandle, RGUsage::TransferSrc }, { swapchainImg, RGUsage::TransferDst } }, [this, swapchainImageIndex](VkCommandBuffer cmd) {
+        vkutil::copy_img_to_img(cmd, draw_img().img, _swapchainImgs[swapchainImageIndex], _drawExtent, _swapchainExtent);
+    });
 
-    // execute copy from draw img into swapchain
-	vkutil::copy_img_to_img(cmd, _drawImg.img, _swapchainImgs[swapchainImageIndex], _drawExtent, _swapchainExtent);
+    // draw imgui on top of the swapchain img
+    _graph.addPass("imgui", { { swapchainImg, RGUsage::ColorAttachment } }, [this, swapchainImageIndex](VkCommandBuffer cmd) {
+        draw_imgui(cmd, _swapchainImgViews[swapchainImageIndex]);
+    });
 
-    // set swapchain img layout to attachment optimal
-	vkutil::transition_img(cmd, _swapchainImgs[swapchainImageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	// leave the swapchain img ready to present, headless imgs are left ready for readback
+	_graph.exportImage(swapchainImg, _headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
-    // draw imgui to swapchain img
-	draw_imgui(cmd, _swapchainImgViews[swapchainImageIndex]);
+    _graph.execute(cmd, &_profiler);
 
-	// set swapchain image layout to present
-	vkutil::transition_img(cmd, _swapchainImgs[swapchainImageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    // the next defrag pass releases what it moves at the end of this frame, whose submit signals next_graphics_value().
+    // the copies land in the upload batch flushed by the next frame, so this frame never waits on them
+    _defrag.record(cmd, next_graphics_value());
+
+    _profiler.endScope(cmd, frameScope);
 
 	// finish recordings commands
 	VK_CHECK(vkEndCommandBuffer(cmd));
 
     auto cmdinfo = vkinit::cmd_buffer_submit_info(cmd);
-	auto waitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, get_current_frame()._swapchainSemaphore);
-	auto signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, get_current_frame()._renderSemaphore);
-	auto submit = vkinit::submit_info(&cmdinfo, &signalInfo, &waitInfo);	
-
-	VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, get_current_frame()._renderFence));
 
-    auto presentInfo = vkinit::present_info();
-    presentInfo.pSwapchains = &_swapchain;
-    presentInfo.swapchainCount = 1;
-    presentInfo.pWaitSemaphores = &get_current_frame()._renderSemaphore;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pImageIndices = &swapchainImageIndex;
-
-    VK_CHECK(vkQueuePresentKHR(_graphicsQueue, &presentInfo));
+    VkSemaphoreSubmitInfo waitInfos[3];
+    uint32_t waitCount = 0;
+    if (!_headless)
+        waitInfos[waitCount++] = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, get_current_frame()._swapchainSemaphore);
+    if (asyncCompute)
+        waitInfos[waitCount++] = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, _computeTimeline, computeValue);
+    if (uploadValue)
+        waitInfos[waitCount++] = vkinit::semaphore_submit_info(uploadStages, _uploads.timeline(), uploadValue);
+
+	get_current_frame()._timelineValue = ++_timelineValue;
+	_drawImgBlitValues[_drawImgCurrent] = _timelineValue;
+	VkSemaphoreSubmitInfo signalInfos[] = {
+		vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _timeline, _timelineValue),
+		vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _headless ? VK_NULL_HANDLE : _presentSemaphores[swapchainImageIndex]),
+	};
+	auto submit = vkinit::submit_info(&cmdinfo, signalInfos, waitCount ? waitInfos : nullptr, _headless ? 1 : 2, waitCount);
+
+	VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, nullptr));
+
+	if (!_headless) {
+		auto presentInfo = vkinit::present_info();
+		presentInfo.pSwapchains = &_swapchain;
+		presentInfo.swapchainCount = 1;
+		presentInfo.pWaitSemaphores = &_presentSemaphores[swapchainImageIndex];
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pImageIndices = &swapchainImageIndex;
+
+		auto e = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+		if (e == VK_ERROR_OUT_OF_DATE_KHR || e == VK_SUBOPTIMAL_KHR) _resizeRequested = true;
+		else VK_CHECK(e);
+	}
 
 	_frameNum++;
 }
 
 void Renderer::draw_background(VkCommandBuffer cmd) {
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _gradientPipeline);
+    dispatch_gradient(cmd, _gradientPipelines[_gradientGrid], _gradientGroupSize, _drawExtent);
+}
+
+void Renderer::dispatch_gradient(VkCommandBuffer cmd, VkPipeline pipeline, VkExtent2D groupSize, VkExtent2D extent) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
 
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _gradientPipelineLayout, 0, 1, &_drawImgDescriptors, 0, nullptr);
+    // headless runs step a fixed 1/60s per frame, same as imgui, so their output is reproducible
+    GradientPushConstants pc = {};
+    pc.drawImg = _drawImgIndices[_drawImgCurrent];
+    pc.time = _headless ? _frameNum / 60.0f : (float)glfwGetTime();
+    pc.extent = { extent.width, extent.height };
 
-    vkCmdDispatch(cmd, std::ceil(_drawExtent.width / 16.0), std::ceil(_drawExtent.height / 16.0), 1);
+    _bindless.bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _gradientPipelineLayout);
+    vkutil::push_constants(cmd, _gradientPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, pc);
+
+    vkCmdDispatch(cmd, (extent.width + groupSize.width - 1) / groupSize.width,
+        (extent.height + groupSize.height - 1) / groupSize.height, 1);
 }
 
 void Renderer::init_vk() {
@@ -145,6 +294,7 @@ void Renderer::init_vk() {
 		.request_validation_layers(VULKAN_DEBUG_REPORT)
 		.use_default_debug_messenger()
 		.require_api_version(1, 3, 0)
+		.set_headless(_headless)
 		.build();
     if (!vkbInstance) {
         fmt::print("error creating instance: {}\n", vkbInstance.error().message());
@@ -154,17 +304,26 @@ void Renderer::init_vk() {
 	_instance = vkbInstance.value().instance;
 	_dbgMsgr = vkbInstance.value().debug_messenger;
 
-    VK_CHECK(glfwCreateWindowSurface(_instance, _wnd, nullptr, &_surface));
+    if (!_headless) VK_CHECK(glfwCreateWindowSurface(_instance, _wnd, nullptr, &_surface));
 
     VkPhysicalDeviceVulkan13Features features = {};
     features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
 	features.dynamicRendering = true;
 	features.synchronization2 = true;
+	features.maintenance4 = true; // LocalSizeId, workgroup sizes from spec constants
 
 	VkPhysicalDeviceVulkan12Features features12 = {};
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 	features12.bufferDeviceAddress = true;
 	features12.descriptorIndexing = true;
+	features12.runtimeDescriptorArray = true;
+	features12.descriptorBindingPartiallyBound = true;
+	features12.descriptorBindingSampledImageUpdateAfterBind = true;
+	features12.descriptorBindingStorageImageUpdateAfterBind = true;
+	features12.descriptorBindingStorageBufferUpdateAfterBind = true;
+	features12.shaderSampledImageArrayNonUniformIndexing = true;
+	features12.shaderStorageBufferArrayNonUniformIndexing = true;
+	features12.timelineSemaphore = true;
 
 	vkb::PhysicalDeviceSelector selector(vkbInstance.value());
 	auto vkbPhysicalDevice = selector
@@ -178,7 +337,21 @@ void Renderer::init_vk() {
         abort();
     }
 
-	vkb::DeviceBuilder deviceBuilder(vkbPhysicalDevice.value());
+	// descriptor buffers are optional and only asked for by the descriptor bench, transient sets fall back to
+	// pools without them. pipelines using them can't bind the bindless set, so the frame doesn't
+	vkb::PhysicalDevice& physDevice = vkbPhysicalDevice.value();
+	if (_enableDescriptorBuffers) {
+		VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {};
+		descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+		descriptorBufferFeatures.descriptorBuffer = true;
+		_descriptorBuffers = physDevice.enable_extension_if_present(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)
+			&& physDevice.enable_extension_features_if_present(descriptorBufferFeatures);
+	}
+
+	// real per heap budgets from the os, without it vma estimates them from the heap sizes
+	_memoryBudget = physDevice.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+	vkb::DeviceBuilder deviceBuilder(physDevice);
 	auto vkbDevice = deviceBuilder.build();
     if (!vkbDevice) {
         fmt::print("error creating device: {}\n", vkbDevice.error().message());
@@ -191,28 +364,70 @@ void Renderer::init_vk() {
     _graphicsQueue = vkbDevice.value().get_queue(vkb::QueueType::graphics).value();
 	_graphicsQueueFamily = vkbDevice.value().get_queue_index(vkb::QueueType::graphics).value();
 
-    _computeQueue = vkbDevice.value().get_queue(vkb::QueueType::compute).value();
-	_computeQueueFamily = vkbDevice.value().get_queue_index(vkb::QueueType::compute).value();
+    // not every device has a compute family separate from graphics, fall back to the graphics queue
+    auto computeQueue = vkbDevice.value().get_queue(vkb::QueueType::compute);
+    if (computeQueue) {
+        _computeQueue = computeQueue.value();
+        _computeQueueFamily = vkbDevice.value().get_queue_index(vkb::QueueType::compute).value();
+    } else {
+        _computeQueue = _graphicsQueue;
+        _computeQueueFamily = _graphicsQueueFamily;
+    }
+
+    // same for a dedicated transfer (dma) family
+    auto transferQueue = vkbDevice.value().get_queue(vkb::QueueType::transfer);
+    if (transferQueue) {
+        _transferQueue = transferQueue.value();
+        _transferQueueFamily = vkbDevice.value().get_queue_index(vkb::QueueType::transfer).value();
+    } else {
+        _transferQueue = _graphicsQueue;
+        _transferQueueFamily = _graphicsQueueFamily;
+    }
 
     VmaAllocatorCreateInfo allocInfo = {};
     allocInfo.physicalDevice = _physDev;
     allocInfo.device = _dev;
     allocInfo.instance = _instance;
     allocInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if (_memoryBudget) allocInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     vmaCreateAllocator(&allocInfo, &_allocator);
+    _memory.init(_physDev, _allocator, _memoryBudget);
 
     _primaryDeletionQueue.push([&]() {
         vmaDestroyAllocator(_allocator);
     });
+
+    // long lived vertex, index, uniform and storage data shares a few big buffers
+    _buffers.init(_dev, _physDev, _allocator);
+    _primaryDeletionQueue.push([&]() {
+        _buffers.destroy();
+    });
 }
 
 void Renderer::init_swapchain() {
-    create_swapchain();
+    if (_headless) create_headless_targets();
+    else create_swapchain();
+
+    // size the draw img for the largest the window is likely to get, so resizes don't have to reallocate it
+    VkExtent2D drawExtent = _wndExtent;
+    GLFWmonitor* monitor = _headless ? nullptr : glfwGetPrimaryMonitor();
+    if (monitor) {
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        drawExtent.width = std::max(drawExtent.width, (uint32_t)mode->width);
+        drawExtent.height = std::max(drawExtent.height, (uint32_t)mode->height);
+    }
+    // a second one only pays off when compute can run alongside graphics
+    _drawImgCount = _computeQueueFamily != _graphicsQueueFamily ? MAX_DRAW_IMGS : 1;
+    create_draw_imgs(drawExtent);
 
-    VkExtent3D drawImageExtent = { _wndExtent.width, _wndExtent.height, 1 };
+    _primaryDeletionQueue.push([=]() {
+		destroy_draw_imgs();
+	});
+}
 
-    _drawImg.format = VK_FORMAT_R16G16B16A16_SFLOAT; // hardcode 32 bit float format
-    _drawImg.extent = drawImageExtent;
+void Renderer::create_draw_imgs(VkExtent2D extent) {
+    VkExtent3D drawImageExtent = { extent.width, extent.height, 1 };
+    VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT; // hardcode 32 bit float format
 
     VkImageUsageFlags drawImageUsages = {};
 	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
@@ -220,24 +435,37 @@ void Renderer::init_swapchain() {
 	drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
 	drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-    // alloc and create img
-    auto rImgInfo = vkinit::img_create_info(_drawImg.format, drawImageUsages, drawImageExtent);
+    auto rImgInfo = vkinit::img_create_info(format, drawImageUsages, drawImageExtent);
     VmaAllocationCreateInfo rImgAllocInfo = {};
 	rImgAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 	rImgAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vmaCreateImage(_allocator, &rImgInfo, &rImgAllocInfo, &_drawImg.img, &_drawImg.allocation, nullptr);
 
-    // create img view for draw img
-    auto rViewInfo = vkinit::imgview_create_info(_drawImg.format, _drawImg.img, VK_IMAGE_ASPECT_COLOR_BIT);
-    VK_CHECK(vkCreateImageView(_dev, &rViewInfo, nullptr, &_drawImg.view));
+    for (uint32_t i = 0; i < _drawImgCount; i++) {
+        auto& img = _drawImgs[i];
+        img.format = format;
+        img.extent = drawImageExtent;
 
-    _primaryDeletionQueue.push([=]() {
-		vkDestroyImageView(_dev, _drawImg.view, nullptr);
-		vmaDestroyImage(_allocator, _drawImg.img, _drawImg.allocation);
-	});
+        // alloc and create img
+        VK_CHECK(vmaCreateImage(_allocator, &rImgInfo, &rImgAllocInfo, &img.img, &img.allocation, nullptr));
+        vkutil::track_allocation(_allocator, img.allocation, MemoryCategory::RenderTargets);
+
+        // create img view for draw img
+        auto rViewInfo = vkinit::imgview_create_info(img.format, img.img, VK_IMAGE_ASPECT_COLOR_BIT);
+        VK_CHECK(vkCreateImageView(_dev, &rViewInfo, nullptr, &img.view));
+    }
 }
 
-void Renderer::create_swapchain() {
+void Renderer::destroy_draw_imgs() {
+    for (uint32_t i = 0; i < _drawImgCount; i++) {
+        auto& img = _drawImgs[i];
+        vkDestroyImageView(_dev, img.view, nullptr);
+        vkutil::untrack_allocation(_allocator, img.allocation);
+        vmaDestroyImage(_allocator, img.img, img.allocation);
+        img = {};
+    }
+}
+
+void Renderer::create_swapchain(VkSwapchainKHR oldSwapchain) {
     vkb::SwapchainBuilder swapchainBuilder(_physDev, _dev, _surface);
 	_swapchainImgFormat = VK_FORMAT_B8G8R8A8_UNORM;
 
@@ -246,6 +474,7 @@ void Renderer::create_swapchain() {
 		.set_desired_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)
         .set_desired_extent(_wndExtent.width, _wndExtent.height)
 		.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+		.set_old_swapchain(oldSwapchain)
 		.build();
     if (!vkbSwapchain) {
         fmt::print("error creating swapchain: {}\n", vkbSwapchain.error().message());
@@ -256,187 +485,288 @@ void Renderer::create_swapchain() {
 	_swapchain = vkbSwapchain.value().swapchain;
 	_swapchainImgs = vkbSwapchain.value().get_images().value();
 	_swapchainImgViews = vkbSwapchain.value().get_image_views().value();
+	_swapchainImgFormat = vkbSwapchain.value().image_format;
+
+	// img count may differ from the old swapchain's, so present semaphores always match the new one
+	create_present_semaphores();
 }
 
 void Renderer::destroy_swapchain() {
+    destroy_present_semaphores();
     vkDestroySwapchainKHR(_dev, _swapchain, nullptr);
     for (int i = 0; i < _swapchainImgViews.size(); i++) {
         vkDestroyImageView(_dev, _swapchainImgViews[i], nullptr);
     }
 }
 
-void Renderer::rebuild_swapchain() {
-    vkQueueWaitIdle(_graphicsQueue);
-
-    vkb::SwapchainBuilder swapchainBuilder(_physDev, _dev, _surface);
-
-    glfwGetWindowSize(_wnd, (int*)&_wndExtent.width, (int*)&_wndExtent.height);
-
-	vkDestroySwapchainKHR(_dev, _swapchain, nullptr);
-	vkDestroyImageView(_dev, _drawImg.view, nullptr);
-	vmaDestroyImage(_allocator, _drawImg.img, _drawImg.allocation);
-	
-	auto vkbSwapchain = swapchainBuilder
-		.set_desired_format(VkSurfaceFormatKHR{ .format = _swapchainImgFormat, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR })
-		.set_desired_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)
-        .set_desired_extent(_wndExtent.width, _wndExtent.height)
-		.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
-		.build();
-    if (!vkbSwapchain) {
-        fmt::print("error creating swapchain: {}\n", vkbSwapchain.error().message());
-        abort();
-    }
+void Renderer::create_headless_targets() {
+    _swapchainImgFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    _swapchainExtent = _wndExtent;
 
-	_swapchain = vkbSwapchain.value().swapchain;
-	_swapchainImgs = vkbSwapchain.value().get_images().value();
-	_swapchainImgViews = vkbSwapchain.value().get_image_views().value();
-	_swapchainImgFormat = vkbSwapchain.value().image_format;
+    VkImageUsageFlags usages = {};
+    usages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    usages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    usages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-	VkExtent3D drawImageExtent = { _wndExtent.width, _wndExtent.height, 1 };
+    VmaAllocationCreateInfo imgAllocInfo = {};
+    imgAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    imgAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	_drawImg.format = VK_FORMAT_R16G16B16A16_SFLOAT; // hardcode 32 bit float format
+    // one img per possible frame in flight, so a frame never writes an img an earlier frame is still using
+    _headlessImgs.resize(MAX_FRAME_OVERLAP);
+    for (auto& img : _headlessImgs) {
+        img.format = _swapchainImgFormat;
+        img.extent = { _swapchainExtent.width, _swapchainExtent.height, 1 };
 
-	VkImageUsageFlags drawImageUsages = {};
-	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
+        auto imgInfo = vkinit::img_create_info(img.format, usages, img.extent);
+        VK_CHECK(vmaCreateImage(_allocator, &imgInfo, &imgAllocInfo, &img.img, &img.allocation, nullptr));
+        vkutil::track_allocation(_allocator, img.allocation, MemoryCategory::RenderTargets);
 
-	auto imgCreateInfo = vkinit::img_create_info(_drawImg.format, drawImageUsages, drawImageExtent);
+        auto viewInfo = vkinit::imgview_create_info(img.format, img.img, VK_IMAGE_ASPECT_COLOR_BIT);
+        VK_CHECK(vkCreateImageView(_dev, &viewInfo, nullptr, &img.view));
 
-	// alloc draw img from gpu local heap
-	VmaAllocationCreateInfo imgAllocInfo = {};
-	imgAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	imgAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        _swapchainImgs.push_back(img.img);
+        _swapchainImgViews.push_back(img.view);
+    }
+}
 
-	// create img
-	vmaCreateImage(_allocator, &imgCreateInfo, &imgAllocInfo, &_drawImg.img, &_drawImg.allocation, nullptr);
+void Renderer::destroy_headless_targets() {
+    for (auto& img : _headlessImgs) {
+        vkDestroyImageView(_dev, img.view, nullptr);
+        vkutil::untrack_allocation(_allocator, img.allocation);
+        vmaDestroyImage(_allocator, img.img, img.allocation);
+    }
+    _headlessImgs.clear();
+    _swapchainImgs.clear();
+    _swapchainImgViews.clear();
+}
 
-    // create draw img view
-	auto imgviewInfo = vkinit::imgview_create_info(_drawImg.format, _drawImg.img, VK_IMAGE_ASPECT_COLOR_BIT);
+void Renderer::create_present_semaphores() {
+    auto semaphoreCreateInfo = vkinit::semaphore_create_info();
+    _presentSemaphores.resize(_swapchainImgs.size());
+    for (auto& semaphore : _presentSemaphores) {
+        VK_CHECK(vkCreateSemaphore(_dev, &semaphoreCreateInfo, nullptr, &semaphore));
+    }
+}
 
-	VK_CHECK(vkCreateImageView(_dev, &imgviewInfo, nullptr, &_drawImg.view));
+void Renderer::destroy_present_semaphores() {
+    for (auto semaphore : _presentSemaphores) {
+        vkDestroySemaphore(_dev, semaphore, nullptr);
+    }
+    _presentSemaphores.clear();
+}
 
-	VkDescriptorImageInfo imgInfo = {};
-	imgInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	imgInfo.imageView = _drawImg.view;
+uint64_t Renderer::next_graphics_value() const {
+    // only graphics submits signal _timeline, async compute signals _computeTimeline
+    return _timelineValue + 1;
+}
 
-	VkWriteDescriptorSet cameraWrite = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _drawImgDescriptors, &imgInfo, 0);
-	vkUpdateDescriptorSets(_dev, 1, &cameraWrite, 0, nullptr);
+void Renderer::rebuild_swapchain() {
+    glfwGetWindowSize(_wnd, (int*)&_wndExtent.width, (int*)&_wndExtent.height);
+    if (_wndExtent.width == 0 || _wndExtent.height == 0) return; // minimised, try again next frame
+
+    // the old swapchain keeps presenting what's queued while the new one is built from it.
+    // presents aren't fenced, so the old one and everything tied to it goes once a graphics submit queued
+    // after its last present has finished, rather than once the queue is idle
+    VkSwapchainKHR oldSwapchain = _swapchain;
+    std::vector<VkImageView> oldViews = std::move(_swapchainImgViews);
+    std::vector<VkSemaphore> oldSemaphores = std::move(_presentSemaphores);
+    _swapchainImgViews.clear();
+    _presentSemaphores.clear();
+
+    create_swapchain(oldSwapchain);
+
+    uint64_t retireValue = next_graphics_value();
+    for (auto view : oldViews) _retireQueue.push(retireValue, view);
+    for (auto semaphore : oldSemaphores) _retireQueue.push(retireValue, semaphore);
+    _retireQueue.push(retireValue, oldSwapchain);
+
+    _resizeRequested = false;
+
+    // the draw img only has to grow, a smaller swapchain just renders into part of it
+    VkExtent3D oldExtent = _drawImgs[0].extent;
+    if (_swapchainExtent.width <= oldExtent.width && _swapchainExtent.height <= oldExtent.height) return;
+
+    // the old imgs keep their bindless slots until the frames using them are done, the new ones get fresh slots
+    for (uint32_t i = 0; i < _drawImgCount; i++) {
+        _retireQueue.pushBindless(retireValue, BindlessType::StorageImage, _drawImgIndices[i]);
+        _retireQueue.push(retireValue, _drawImgs[i]);
+    }
 
-	_primaryDeletionQueue.push([&]() {
-		vkDestroyImageView(_dev, _drawImg.view, nullptr);
-		vmaDestroyImage(_allocator, _drawImg.img, _drawImg.allocation);
-	});
+    VkExtent2D drawExtent = {
+        std::max(_swapchainExtent.width, oldExtent.width),
+        std::max(_swapchainExtent.height, oldExtent.height),
+    };
+    create_draw_imgs(drawExtent);
+    for (uint32_t i = 0; i < _drawImgCount; i++) _drawImgIndices[i] = _bindless.addStorageImage(_dev, _drawImgs[i].view);
 }
 
 void Renderer::init_cmds() {
 
-    auto cmdPoolInfo = vkinit::cmd_pool_create_info(_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
-		VK_CHECK(vkCreateCommandPool(_dev, &cmdPoolInfo, nullptr, &_frames[i]._cmdPool));
-        auto cmdAllocInfo = vkinit::cmd_buffer_alloc_info(_frames[i]._cmdPool, 1);
-        VK_CHECK(vkAllocateCommandBuffers(_dev, &cmdAllocInfo, &_frames[i]._cmdBuf));
-	}
-
-    VK_CHECK(vkCreateCommandPool(_dev, &cmdPoolInfo, nullptr, &_imdCmdPool));
-	auto cmdAllocInfo = vkinit::cmd_buffer_alloc_info(_imdCmdPool, 1);
-	VK_CHECK(vkAllocateCommandBuffers(_dev, &cmdAllocInfo, &_imdCmdBuf));
+    // the upload service owns its own pool on the transfer family, per frame cmds are made in init_frames
+    _uploads.init(_dev, _transferQueue, _transferQueueFamily, _graphicsQueueFamily);
 
 	_primaryDeletionQueue.push([=]() { 
-	    vkDestroyCommandPool(_dev, _imdCmdPool, nullptr);
+	    _uploads.destroy(_dev);
 	});
 }
 
 void Renderer::init_sync() {
 
-    auto fenceCreateInfo = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
+    // timeline starts at 0, so waits on a frame that has never been submitted return immediately
+    auto timelineTypeInfo = vkinit::semaphore_type_create_info(VK_SEMAPHORE_TYPE_TIMELINE, 0);
+    auto timelineCreateInfo = vkinit::semaphore_create_info();
+    timelineCreateInfo.pNext = &timelineTypeInfo;
+    VK_CHECK(vkCreateSemaphore(_dev, &timelineCreateInfo, nullptr, &_timeline));
+    VK_CHECK(vkCreateSemaphore(_dev, &timelineCreateInfo, nullptr, &_computeTimeline));
+
+	_primaryDeletionQueue.push([=]() {
+        vkDestroySemaphore(_dev, _computeTimeline, nullptr);
+        vkDestroySemaphore(_dev, _timeline, nullptr);
+    });
+}
+
+void Renderer::init_frames() {
+
+    _frameOverlap = std::clamp(_frameOverlap, 1u, MAX_FRAME_OVERLAP);
+
+    auto cmdPoolInfo = vkinit::cmd_pool_create_info(_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
     auto semaphoreCreateInfo = vkinit::semaphore_create_info();
 
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
-		VK_CHECK(vkCreateFence(_dev, &fenceCreateInfo, nullptr, &_frames[i]._renderFence));
+    for (uint32_t i = 0; i < _frameOverlap; i++) {
+		VK_CHECK(vkCreateCommandPool(_dev, &cmdPoolInfo, nullptr, &_frames[i]._cmdPool));
+        auto cmdAllocInfo = vkinit::cmd_buffer_alloc_info(_frames[i]._cmdPool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(_dev, &cmdAllocInfo, &_frames[i]._cmdBuf));
+
 		VK_CHECK(vkCreateSemaphore(_dev, &semaphoreCreateInfo, nullptr, &_frames[i]._swapchainSemaphore));
-		VK_CHECK(vkCreateSemaphore(_dev, &semaphoreCreateInfo, nullptr, &_frames[i]._renderSemaphore));
+        _frames[i]._timelineValue = 0;
+        _frames[i]._arena.init(FRAME_ARENA_SIZE, true);
+
+        if (_computeQueueFamily != _graphicsQueueFamily) {
+            auto computePoolInfo = vkinit::cmd_pool_create_info(_computeQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+            VK_CHECK(vkCreateCommandPool(_dev, &computePoolInfo, nullptr, &_frames[i]._computeCmdPool));
+            auto computeAllocInfo = vkinit::cmd_buffer_alloc_info(_frames[i]._computeCmdPool, 1);
+            VK_CHECK(vkAllocateCommandBuffers(_dev, &computeAllocInfo, &_frames[i]._computeCmdBuf));
+        }
 	}
 
-    VK_CHECK(vkCreateFence(_dev, &fenceCreateInfo, nullptr, &_imdFence));
-	_primaryDeletionQueue.push([=]() {
-        vkDestroyFence(_dev, _imdFence, nullptr);
-    });
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(_physDev, &props);
+    VkDeviceSize ringAlignment = std::max(props.limits.minUniformBufferOffsetAlignment, props.limits.minStorageBufferOffsetAlignment);
+    _frameRing.init(_allocator, FRAME_RING_SIZE, _frameOverlap, ringAlignment);
 }
 
-void Renderer::init_descriptors() {
+void Renderer::destroy_frames() {
+    for (uint32_t i = 0; i < _frameOverlap; i++) {
+        vkDestroyCommandPool(_dev, _frames[i]._cmdPool, nullptr);
+        vkDestroySemaphore(_dev, _frames[i]._swapchainSemaphore, nullptr);
+        if (_frames[i]._computeCmdPool) vkDestroyCommandPool(_dev, _frames[i]._computeCmdPool, nullptr);
+        _frames[i]._computeCmdPool = VK_NULL_HANDLE;
 
-    // init descriptor allocator with 10 sets
-    std::vector<DescriptorAllocator::PoolSizeRatio> sizes = {
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
-    };
-    _descriptorAllocator.initPool(_dev, 10, sizes);
-    
-    { // create descriptor set layout for compute draw
-        DescriptorLayoutBuilder builder = {};
-        builder.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-        _drawImgDescriptorLayout = builder.build(_dev, VK_SHADER_STAGE_COMPUTE_BIT);
+        _frames[i]._arena.destroy();
     }
+    _frameRing.destroy(_allocator);
+}
 
-    // allocate descriptor set for draw img
-    _drawImgDescriptors = _descriptorAllocator.allocate(_dev, _drawImgDescriptorLayout);
+void Renderer::set_frame_overlap(uint32_t count) {
+    count = std::clamp(count, 1u, MAX_FRAME_OVERLAP);
+    if (count == _frameOverlap) return;
 
-    VkDescriptorImageInfo imgInfo = {};
-    imgInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    imgInfo.imageView = _drawImg.view;
+    // every frame's graphics submit is <= _timelineValue and waited on the frame's compute, so this drains all of them
+    wait_timeline(_timelineValue);
+
+    destroy_frames();
+    _profiler.destroy(_dev);
+    _computeProfiler.destroy(_dev);
+    _frameOverlap = count;
+    init_frames();
+    init_profilers();
+}
+
+void Renderer::init_profilers() {
+    // each queue checks its own family's timestampValidBits
+    _profiler.init(_dev, _physDev, _graphicsQueueFamily, _frameOverlap, "gpu profiler (graphics)");
+    if (_computeQueueFamily != _graphicsQueueFamily) {
+        _computeProfiler.init(_dev, _physDev, _computeQueueFamily, _frameOverlap, "gpu profiler (compute)");
+    }
+}
 
-    VkWriteDescriptorSet drawImgWrite = {};
-    drawImgWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	drawImgWrite.pNext = nullptr;
-    drawImgWrite.dstBinding = 0;
-	drawImgWrite.dstSet = _drawImgDescriptors;
-	drawImgWrite.descriptorCount = 1;
-	drawImgWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-	drawImgWrite.pImageInfo = &imgInfo;
+void Renderer::init_descriptors() {
 
-    vkUpdateDescriptorSets(_dev, 1, &drawImgWrite, 0, nullptr); // updates desc set with draw img
+    // every img and buffer the shaders touch is reached through the bindless heap
+    _bindless.init(_dev, _physDev);
+    for (uint32_t i = 0; i < _drawImgCount; i++) _drawImgIndices[i] = _bindless.addStorageImage(_dev, _drawImgs[i].view);
+    _retireQueue.init(_dev, _allocator, &_bindless, &_buffers);
+    _defrag.init(_dev, _allocator, _timeline, &_bindless, &_uploads);
 
     _primaryDeletionQueue.push([&]() {
-        _descriptorAllocator.destroyPool(_dev);
-        vkDestroyDescriptorSetLayout(_dev, _drawImgDescriptorLayout, nullptr);
+        _defrag.destroy();
+        _bindless.destroy(_dev);
     });
 }
 
 void Renderer::init_pipelines() {
-    VkPipelineLayoutCreateInfo computeLayout = {};
-    computeLayout.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	computeLayout.pNext = nullptr;
-	computeLayout.pSetLayouts = &_drawImgDescriptorLayout;
-	computeLayout.setLayoutCount = 1;
-
-    VK_CHECK(vkCreatePipelineLayout(_dev, &computeLayout, nullptr, &_gradientPipelineLayout));
-
-    // pipeline layout
-    VkShaderModule computeDrawShader = {};
-	if (!vkutil::load_shader_module("gradient.spv", _dev, &computeDrawShader)) {
-		fmt::print("error building shader \n");
-	}
+    // saved on shutdown, so the next launch skips the driver's shader compile
+    _pipelineCache.init(_dev, _physDev, "pipeline_cache.bin");
+    _primaryDeletionQueue.push([=]() {
+        _pipelineCache.save(_dev);
+        _pipelineCache.destroy(_dev);
+    });
 
-    VkPipelineShaderStageCreateInfo stageinfo = {};
-	stageinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	stageinfo.pNext = nullptr;
-	stageinfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-	stageinfo.module = computeDrawShader;
-	stageinfo.pName = "main";
-
-	VkComputePipelineCreateInfo computePipelineCreateInfo = {};
-	computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-	computePipelineCreateInfo.pNext = nullptr;
-	computePipelineCreateInfo.layout = _gradientPipelineLayout;
-	computePipelineCreateInfo.stage = stageinfo;
-	
-	VK_CHECK(vkCreateComputePipelines(_dev, nullptr, 1, &computePipelineCreateInfo, nullptr, &_gradientPipeline));
+    // shaders not compiled into the binary come from the archive next to it. missing is fine
+    // as long as everything was embedded, the registry aborts on a shader it can't find anywhere
+    _shaderArchive.open(vkutil::executable_dir() / "shaders.pak");
 
-    vkDestroyShaderModule(_dev, computeDrawShader, nullptr);
-	_primaryDeletionQueue.push([&]() {
-		vkDestroyPipelineLayout(_dev, _gradientPipelineLayout, nullptr);
-		vkDestroyPipeline(_dev, _gradientPipeline, nullptr);
-	});
+    // registry owns the pipelines and shader modules from here on
+    _pipelines.init(&_pipelineCache, &_shaderArchive);
+    _primaryDeletionQueue.push([=]() {
+        _pipelines.destroy(_dev);
+        _shaderArchive.close();
+    });
+
+    // layouts come from the shaders themselves, a runtime array set resolves to the bindless heap
+    _layouts.setBindlessLayout(_bindless.layout());
+    _primaryDeletionQueue.push([&]() {
+        _layouts.destroy(_dev);
+    });
+
+    VkShaderModule gradient = _pipelines.shader(_dev, "gradient.spv");
+    auto& gradientReflection = _pipelines.reflection(gradient);
+    _gradientPipelineLayout = _layouts.pipelineLayout(_dev, { &gradientReflection });
+    if (gradientReflection.pushConstantSize != sizeof(GradientPushConstants)) {
+        fmt::print("gradient.spv push constants are {} bytes, GradientPushConstants is {}\n", gradientReflection.pushConstantSize, sizeof(GradientPushConstants));
+        abort();
+    }
+    auto gradientBuilder = ComputePipelineBuilder()
+        .setShader(gradient)
+        .setLayout(_gradientPipelineLayout);
+
+    // benchmarked once per device over the whole draw img, later runs read the size back from the file.
+    // there's no draw extent before the first frame, so the benchmark can't use it
+    VkExtent2D tuneExtent = { _drawImgs[0].extent.width, _drawImgs[0].extent.height };
+    _tuner.init(_dev, _physDev, _graphicsQueueFamily, _graphicsQueue, "workgroup_sizes.txt");
+    _gradientGroupSize = _tuner.tune(_dev, _pipelines, "gradient", gradientBuilder, gradientReflection,
+        [this](VkCommandBuffer cmd) {
+            vkutil::transition_img(cmd, _drawImgs[0].img, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+        },
+        [this, tuneExtent](VkCommandBuffer cmd, VkPipeline pipeline, VkExtent2D groupSize) {
+            dispatch_gradient(cmd, pipeline, groupSize, tuneExtent);
+        });
+    _tuner.save();
+    _tuner.destroy(_dev);
+
+    // spec ids come from the shader, so a build with a fixed numthreads just keeps its own size
+    auto& specIds = gradientReflection.localSizeSpecIds;
+    if (specIds[0] != UINT32_MAX && specIds[1] != UINT32_MAX) {
+        gradientBuilder.setSpecialization(specIds[0], _gradientGroupSize.width).setSpecialization(specIds[1], _gradientGroupSize.height);
+    }
+
+    // every startup pipeline goes in one batch, compiled across all cores
+    PipelineBatch batch;
+    batch.add("gradient", ComputePipelineBuilder(gradientBuilder).setSpecialization(GRADIENT_GRID_SPEC_ID, false), &_gradientPipelines[0]);
+    batch.add("gradient grid", ComputePipelineBuilder(gradientBuilder).setSpecialization(GRADIENT_GRID_SPEC_ID, true), &_gradientPipelines[1]);
+    _pipelines.compile(_dev, batch);
 }
 
 void Renderer::init_imgui() {
@@ -469,7 +799,7 @@ void Renderer::init_imgui() {
 
     // init imgui for glfw/vulkan
     ImGui::CreateContext();
-    ImGui_ImplGlfw_InitForVulkan(_wnd, true);
+    if (!_headless) ImGui_ImplGlfw_InitForVulkan(_wnd, true);
 
     ImGui_ImplVulkan_InitInfo initInfo = {};
 	initInfo.Instance = _instance;
@@ -500,25 +830,19 @@ void Renderer::init_imgui() {
 	});
 }
 
-void Renderer::imd_submit(std::function<void(VkCommandBuffer cmd)>&& fn) {
-    VK_CHECK(vkResetFences(_dev, 1, &_imdFence));
-	VK_CHECK(vkResetCommandBuffer(_imdCmdBuf, 0));
-
-	VkCommandBuffer cmd = _imdCmdBuf;
-
-	auto cmdBeginInfo = vkinit::cmd_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
-
-	fn(cmd);
-
-	VK_CHECK(vkEndCommandBuffer(cmd));
+UploadToken Renderer::upload(std::function<void(VkCommandBuffer cmd)>&& fn) {
+	return _uploads.enqueue(_dev, std::move(fn));
+}
 
-	auto cmdinfo = vkinit::cmd_buffer_submit_info(cmd);
-	auto submit = vkinit::submit_info(&cmdinfo, nullptr, nullptr);
+uint64_t Renderer::completed_timeline_value() {
+	uint64_t value = 0;
+	VK_CHECK(vkGetSemaphoreCounterValue(_dev, _timeline, &value));
+	return value;
+}
 
-	VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, _imdFence));
-	VK_CHECK(vkWaitForFences(_dev, 1, &_imdFence, true, 9999999999));
+void Renderer::wait_timeline(uint64_t value, uint64_t timeout) {
+	auto waitInfo = vkinit::semaphore_wait_info(&_timeline, &value);
+	VK_CHECK(vkWaitSemaphores(_dev, &waitInfo, timeout));
 }
 
 void Renderer::draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView) {
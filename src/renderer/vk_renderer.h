@@ -1,7 +1,19 @@
 #pragma once
 #include "vk_common.h"
+#include "vk_autotune.h"
+#include "vk_bindless.h"
+#include "vk_buffers.h"
+#include "vk_defrag.h"
 #include "vk_descriptors.h"
-
+#include "vk_memory.h"
+#include "vk_pipelines.h"
+#include "vk_profiler.h"
+#include "vk_rendergraph.h"
+#include "vk_retire.h"
+#include "vk_upload.h"
+
+// teardown of the renderer's long lived systems, run once in reverse order by cleanup().
+// anything destroyed while running goes through the RetireQueue instead
 struct DeletionQueue {
 	void push(std::function<void()>&& function) { m_deletors.push_back(function); }
 	void flush() {
@@ -13,91 +25,163 @@ private:
 };
 
 struct FrameData {
-	VkSemaphore _swapchainSemaphore, _renderSemaphore;
-	VkFence _renderFence;
+	VkSemaphore _swapchainSemaphore;
+	uint64_t _timelineValue = 0; // value of _timeline signalled by this frame's graphics submit, which waits on its compute
 
 	VkCommandPool _cmdPool;
 	VkCommandBuffer _cmdBuf;
 
-	DeletionQueue _deletionQueue;
+	// only created when the compute queue has its own family
+	VkCommandPool _computeCmdPool = VK_NULL_HANDLE;
+	VkCommandBuffer _computeCmdBuf = VK_NULL_HANDLE;
+
+	LinearArena _arena; // cpu side frame data (render graph passes), reset once the frame retires
 };
 
-const uint32_t FRAME_OVERLAP = 2;
+const uint32_t MAX_FRAME_OVERLAP = 4;
+const uint32_t MAX_DRAW_IMGS = 2; // double buffered when compute runs async, so it can fill one while graphics blits the other
+const VkDeviceSize FRAME_RING_SIZE = 8 * 1024 * 1024; // per frame in flight
+const size_t FRAME_ARENA_SIZE = 2 * 1024 * 1024; // per frame in flight, one huge page
+const uint32_t GRADIENT_GRID_SPEC_ID = 2; // GRID_LINES in gradient.comp.hlsl
+
+// PushConstants in gradient.comp.hlsl
+struct GradientPushConstants {
+	uint32_t drawImg;
+	float time;
+	glm::uvec2 extent;
+};
 
 class Renderer {
 public:
 
     bool _isInitialised = false;
 	bool _stopRendering = false;
+	bool _headless = false; // render into offscreen imgs, no window, surface or swapchain
 	
-    GLFWwindow* _wnd;
+    GLFWwindow* _wnd = nullptr;
 	VkExtent2D _wndExtent = {};
 
+	uint32_t _frameOverlap = 2; // frames in flight, 1 to MAX_FRAME_OVERLAP
+
     VkInstance _instance;
 	VkDebugUtilsMessengerEXT _dbgMsgr;
     VkPhysicalDevice _physDev;
 	VkDevice _dev;
 	
 	uint64_t _frameNum = 0;
-	FrameData _frames[FRAME_OVERLAP];
-	FrameData& get_current_frame() { return _frames[_frameNum % FRAME_OVERLAP]; };
+	FrameData _frames[MAX_FRAME_OVERLAP];
+	FrameData& get_current_frame() { return _frames[_frameNum % _frameOverlap]; };
+
+	// graphics timeline, every graphics submit signals the next value. async compute has its own, as a
+	// timeline's signals have to increase in the order they execute and the queues finish out of order
+	VkSemaphore _timeline;
+	uint64_t _timelineValue = 0; // last value submitted
+	VkSemaphore _computeTimeline;
+	uint64_t _computeTimelineValue = 0; // last value submitted, every one is waited on by its frame's graphics submit
 
 	VmaAllocator _allocator;
+	MemoryBudget _memory; // per heap budgets, polled every frame, with eviction callbacks for streaming
 	DeletionQueue _primaryDeletionQueue;
+	RetireQueue _retireQueue; // resources replaced at runtime, freed once the gpu is done with them
 
 	VkQueue _graphicsQueue;
 	uint32_t _graphicsQueueFamily;
-	VkQueue _computeQueue;
+	VkQueue _computeQueue; // same as _graphicsQueue when there is no separate compute family
 	uint32_t _computeQueueFamily;
-
-	VkSurfaceKHR _surface;
+	bool _asyncCompute = true; // run compute passes on _computeQueue when it has its own family
+	bool _enableDescriptorBuffers = false; // request VK_EXT_descriptor_buffer, only the descriptor bench uses it
+	bool _descriptorBuffers = false; // VK_EXT_descriptor_buffer is enabled
+	bool _memoryBudget = false; // VK_EXT_memory_budget is enabled
+	VkQueue _transferQueue; // same as _graphicsQueue when there is no separate transfer family
+	uint32_t _transferQueueFamily;
+
+	VkSurfaceKHR _surface = VK_NULL_HANDLE;
     VkSwapchainKHR _swapchain;
     VkFormat _swapchainImgFormat;
 	VkExtent2D _swapchainExtent;
-	VkExtent2D _drawExtent;
+	VkExtent2D _drawExtent; // part of draw_img() rendered this frame, min of its extent and the swapchain's
+	bool _resizeRequested = false; // set when acquire or present report the swapchain out of date or suboptimal
 
 	std::vector<VkImage> _swapchainImgs;
 	std::vector<VkImageView> _swapchainImgViews;
-
-	DescriptorAllocator _descriptorAllocator;
-
-	VkPipeline _gradientPipeline;
-	VkPipelineLayout _gradientPipelineLayout;
-
-	VkDescriptorSet _drawImgDescriptors;
-	VkDescriptorSetLayout _drawImgDescriptorLayout;
-
-	VkFence _imdFence;
-    VkCommandBuffer _imdCmdBuf;
-    VkCommandPool _imdCmdPool;
-
-	AllocatedImg _drawImg;
+	std::vector<VkSemaphore> _presentSemaphores; // one per swapchain img, signalled on submit and waited on by present
+	std::vector<AllocatedImg> _headlessImgs; // backs _swapchainImgs in headless mode
+
+	PipelineCache _pipelineCache;
+	ShaderArchive _shaderArchive;
+	PipelineRegistry _pipelines;
+	LayoutCache _layouts;
+
+	VkPipeline _gradientPipelines[2]; // indexed by _gradientGrid
+	VkPipelineLayout _gradientPipelineLayout; // owned by _layouts
+	VkExtent2D _gradientGroupSize; // tuned for this device, see WorkgroupTuner
+	bool _gradientGrid = true;
+	WorkgroupTuner _tuner;
+
+	BindlessHeap _bindless;
+	uint32_t _drawImgIndices[MAX_DRAW_IMGS] = { BINDLESS_INVALID, BINDLESS_INVALID }; // storage img slots of _drawImgs
+
+	UploadService _uploads;
+	FrameRingBuffer _frameRing; // per frame uniform, vertex and staging data, sized by _frameOverlap
+	BufferSuballocator _buffers; // device local ranges for data that outlives a frame, freed through _retireQueue
+	Defragmenter _defrag; // compacts registered imgs and buffers a few MB per frame
+
+	AllocatedImg _drawImgs[MAX_DRAW_IMGS];
+	uint64_t _drawImgBlitValues[MAX_DRAW_IMGS] = {}; // graphics submit that last read each draw img
+	uint32_t _drawImgCount = 1; // MAX_DRAW_IMGS when there's a separate compute family
+	uint32_t _drawImgCurrent = 0; // the one this frame renders into
+	AllocatedImg& draw_img() { return _drawImgs[_drawImgCurrent]; }
+
+	GpuProfiler _profiler; // graphics queue
+	GpuProfiler _computeProfiler; // async compute queue, own pools so its resets never race graphics timestamps
+	RenderGraph _graph; // rebuilt every frame, kept around so its storage is reused
 
 	void init();
     void cleanup();
 	
 	void render();
 
-	void imd_submit(std::function<void(VkCommandBuffer cmd)>&& fn);
+	// waits for in flight work then rebuilds _frames with the new depth
+	void set_frame_overlap(uint32_t count);
+
+	// records fn into the current upload batch on the transfer queue, without waiting for it.
+	// the batch is submitted at the start of the next frame, which waits for it before using anything it released
+	UploadToken upload(std::function<void(VkCommandBuffer cmd)>&& fn);
+
+	// timeline funcs
+	uint64_t completed_timeline_value();
+	// latest value the next graphics submit can signal, see the definition
+	uint64_t next_graphics_value() const;
+	void wait_timeline(uint64_t value, uint64_t timeout = UINT64_MAX);
 
 private:
 	// init funcs
     void init_vk();
 	void init_cmds();
 	void init_sync();
+	void init_frames();
+	void init_profilers();
 	void init_descriptors();
 	void init_pipelines();
 	void init_swapchain();
 	void init_imgui();
 
 	// other funcs
-	void create_swapchain();
+	void create_swapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 	void rebuild_swapchain();
+	void create_draw_imgs(VkExtent2D extent);
+	void destroy_draw_imgs();
 	void destroy_swapchain();
+	void create_headless_targets();
+	void destroy_headless_targets();
+	void destroy_frames();
+	void create_present_semaphores();
+	void destroy_present_semaphores();
 
 	// draw funcs
 	void draw();
 	void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView);
 	void draw_background(VkCommandBuffer cmd);
+	void dispatch_gradient(VkCommandBuffer cmd, VkPipeline pipeline, VkExtent2D groupSize, VkExtent2D extent);
 
 };
\ No newline at end of file
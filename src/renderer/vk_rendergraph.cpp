@@ -0,0 +1,203 @@
+#include "vk_rendergraph.h"
+#include "vk_initialisers.h"
+
+namespace {
+    struct UsageInfo {
+        VkImageLayout layout;
+        VkPipelineStageFlags2 stage;
+        VkAccessFlags2 readAccess;
+        VkAccessFlags2 writeAccess;
+    };
+
+    UsageInfo usage_info(RGUsage usage) {
+        switch (usage) {
+        case RGUsage::StorageWrite:
+            return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+        case RGUsage::StorageRead:
+            return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::SampledRead:
+            return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::ColorAttachment:
+            return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT };
+        case RGUsage::DepthAttachment:
+            return { VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+        case RGUsage::TransferSrc:
+            return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::TransferDst:
+            return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT };
+        case RGUsage::VertexRead:
+            return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::IndexRead:
+            return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::IndirectRead:
+            return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::UniformRead:
+            return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                VK_ACCESS_2_UNIFORM_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::StorageBufferRead:
+            return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::StorageBufferWrite:
+            return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+        case RGUsage::TransferSrcBuffer:
+            return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_ACCESS_2_NONE };
+        case RGUsage::TransferDstBuffer:
+            return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT };
+        }
+        return {};
+    }
+} // namespace
+
+void RenderGraph::reset(LinearArena& arena) {
+    // clear keeps capacity, so a steady state frame doesn't reallocate
+    m_arena = &arena;
+    m_resources.clear();
+    m_passes.clear();
+    m_accesses.clear();
+}
+
+RGHandle RenderGraph::importImage(VkImage img, VkImageLayout layout, VkPipelineStageFlags2 stages, VkAccessFlags2 pendingWrites, VkImageSubresourceRange range) {
+    Resource res = {};
+    res.img = img;
+    res.range = range;
+    res.layout = layout;
+    res.writeStages = stages;
+    res.writeAccess = pendingWrites;
+    res.readStages = pendingWrites ? VK_PIPELINE_STAGE_2_NONE : stages; // nothing to flush, so the stages only need ordering
+    m_resources.push_back(res);
+    return (RGHandle)(m_resources.size() - 1);
+}
+
+RGHandle RenderGraph::importBuffer(VkBuffer buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 pendingWrites) {
+    Resource res = {};
+    res.buffer = buffer;
+    res.writeStages = stages;
+    res.writeAccess = pendingWrites;
+    res.readStages = pendingWrites ? VK_PIPELINE_STAGE_2_NONE : stages;
+    m_resources.push_back(res);
+    return (RGHandle)(m_resources.size() - 1);
+}
+
+void RenderGraph::exportImage(RGHandle img, VkImageLayout layout, VkPipelineStageFlags2 stages) {
+    auto& res = m_resources[img];
+    res.exported = true;
+    res.exportLayout = layout;
+    res.exportStages = stages;
+}
+
+void RenderGraph::exportBuffer(RGHandle buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access) {
+    auto& res = m_resources[buffer];
+    res.exported = true;
+    res.exportStages = stages;
+    res.exportAccess = access;
+}
+
+void RenderGraph::addPass(const char* name, std::initializer_list<RGAccess> accesses, void (*fn)(void* ctx, VkCommandBuffer cmd), void* ctx) {
+    Pass pass = {};
+    pass.name = name;
+    pass.firstAccess = (uint32_t)m_accesses.size();
+    pass.accessCount = (uint32_t)accesses.size();
+    pass.fn = fn;
+    pass.ctx = ctx;
+    m_accesses.insert(m_accesses.end(), accesses.begin(), accesses.end());
+    m_passes.push_back(pass);
+}
+
+void RenderGraph::cull() {
+    // walk backwards from the exports, a pass is live if it writes something a later live pass needs
+    auto needed = m_arena->allocArray<bool>(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); i++) needed[i] = m_resources[i].exported;
+
+    for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); pass++) {
+        pass->live = false;
+        for (uint32_t i = 0; i < pass->accessCount; i++) {
+            auto& access = m_accesses[pass->firstAccess + i];
+            if (usage_info(access.usage).writeAccess && needed[access.resource]) {
+                pass->live = true;
+                break;
+            }
+        }
+        if (!pass->live) continue;
+
+        // a pure overwrite doesn't need earlier writers, anything the pass reads does
+        for (uint32_t i = 0; i < pass->accessCount; i++) {
+            auto& access = m_accesses[pass->firstAccess + i];
+            auto info = usage_info(access.usage);
+            if (info.writeAccess && !info.readAccess) needed[access.resource] = false;
+        }
+        for (uint32_t i = 0; i < pass->accessCount; i++) {
+            auto& access = m_accesses[pass->firstAccess + i];
+            if (usage_info(access.usage).readAccess) needed[access.resource] = true;
+        }
+    }
+}
+
+void RenderGraph::barrier(Resource& res, VkImageLayout layout, VkPipelineStageFlags2 stage, VkAccessFlags2 readAccess, VkAccessFlags2 writeAccess) {
+    bool transition = res.img && res.layout != layout;
+    bool write = writeAccess != VK_ACCESS_2_NONE;
+
+    VkPipelineStageFlags2 srcStage;
+    VkAccessFlags2 srcAccess;
+    if (write || transition) {
+        // first touch with nothing to wait on
+        if (!transition && !res.writeStages && !res.readStages) {
+            res.writeStages = stage;
+            res.writeAccess = writeAccess;
+            return;
+        }
+
+        // WAW/WAR, and layout transitions, which count as writes: wait on everything since the last write
+        srcStage = res.writeStages | res.readStages;
+        srcAccess = res.writeAccess;
+    } else {
+        // RAW, only needed if this stage hasn't been synced with the last write yet
+        if (!res.writeStages || (stage & ~res.readStages) == 0) return;
+        srcStage = res.writeStages;
+        srcAccess = res.writeAccess;
+    }
+
+    if (res.img) {
+        m_barriers.image(res.img, res.layout, layout, srcStage, srcAccess, stage, readAccess | writeAccess, res.range);
+    } else {
+        m_barriers.buffer(res.buffer, srcStage, srcAccess, stage, readAccess | writeAccess);
+    }
+
+    if (write || transition) {
+        res.layout = res.img ? layout : res.layout;
+        res.writeStages = stage;
+        res.writeAccess = writeAccess;
+        res.readStages = write ? VK_PIPELINE_STAGE_2_NONE : stage;
+    } else {
+        res.readStages |= stage;
+    }
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd, GpuProfiler* profiler) {
+    cull();
+
+    for (auto& pass : m_passes) {
+        if (!pass.live) continue;
+
+        for (uint32_t i = 0; i < pass.accessCount; i++) {
+            auto& access = m_accesses[pass.firstAccess + i];
+            auto info = usage_info(access.usage);
+            barrier(m_resources[access.resource], info.layout, info.stage, info.readAccess, info.writeAccess);
+        }
+        m_barriers.flush(cmd);
+
+        uint32_t scope = profiler ? profiler->beginScope(cmd, pass.name) : UINT32_MAX;
+        pass.fn(pass.ctx, cmd);
+        if (profiler) profiler->endScope(cmd, scope);
+    }
+
+    // leave exports in their requested state, batched into one final barrier
+    for (auto& res : m_resources) {
+        if (!res.exported) continue;
+        auto layout = res.img ? res.exportLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier(res, layout, res.exportStages, res.exportAccess, VK_ACCESS_2_NONE);
+    }
+    m_barriers.flush(cmd);
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "vk_common.h"
+#include "vk_arena.h"
+#include "vk_profiler.h"
+#include "vk_images.h"
+
+// how a pass touches a resource, each usage maps to a fixed layout/stage/access
+enum class RGUsage {
+    // images
+    StorageWrite,       // compute storage img write, GENERAL
+    StorageRead,        // compute storage img read, GENERAL
+    SampledRead,        // fragment/compute sampled read, SHADER_READ_ONLY_OPTIMAL
+    ColorAttachment,    // color attachment load/store, COLOR_ATTACHMENT_OPTIMAL
+    DepthAttachment,    // depth test/write, DEPTH_ATTACHMENT_OPTIMAL
+    TransferSrc,        // copy/blit src, TRANSFER_SRC_OPTIMAL
+    TransferDst,        // copy/blit dst, TRANSFER_DST_OPTIMAL
+
+    // buffers
+    VertexRead,
+    IndexRead,
+    IndirectRead,
+    UniformRead,
+    StorageBufferRead,
+    StorageBufferWrite,
+    TransferSrcBuffer,
+    TransferDstBuffer,
+};
+
+using RGHandle = uint32_t;
+
+struct RGAccess {
+    RGHandle resource;
+    RGUsage usage;
+};
+
+// frame graph rebuilt every frame: passes declare what they read and write, passes that don't
+// contribute to an exported resource are culled, and the barriers between the remaining passes
+// are derived from the declared usage and issued as one batch per pass
+struct RenderGraph {
+    // pass callbacks and per frame scratch go in arena, which must outlive execute()
+    void reset(LinearArena& arena);
+
+    // stages = the stages that must finish before the first use (last use, or a semaphore wait stage),
+    // pendingWrites = accesses still to be made available, none if the last use was a read
+    RGHandle importImage(VkImage img, VkImageLayout layout, VkPipelineStageFlags2 stages,
+        VkAccessFlags2 pendingWrites = VK_ACCESS_2_NONE, VkImageSubresourceRange range = vkinit::img_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT));
+    RGHandle importBuffer(VkBuffer buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 pendingWrites = VK_ACCESS_2_NONE);
+
+    // marks a resource as a graph output, left in layout with stages waiting on it once the graph has run
+    void exportImage(RGHandle img, VkImageLayout layout, VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE);
+    void exportBuffer(RGHandle buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access);
+
+    // fn is copied into the arena and never destroyed, so it can only capture trivially destructible
+    // things (pointers, handles, indices), which keeps adding a pass free of heap allocations
+    template <typename Fn> void addPass(const char* name, std::initializer_list<RGAccess> accesses, Fn&& fn) {
+        using Callable = std::decay_t<Fn>;
+        auto callable = m_arena->create<Callable>(std::forward<Fn>(fn));
+        addPass(name, accesses, [](void* ctx, VkCommandBuffer cmd) { (*(Callable*)ctx)(cmd); }, callable);
+    }
+
+    // culls, then records every live pass with its barriers, each pass gets a profiler scope if one is given
+    void execute(VkCommandBuffer cmd, GpuProfiler* profiler = nullptr);
+
+private:
+    struct Resource {
+        VkImage img = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImageSubresourceRange range = {};
+
+        // tracked state
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE; // last write or layout transition
+        VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE; // still to be made available
+        VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE; // stages already synced with the last write
+
+        // export
+        bool exported = false;
+        VkImageLayout exportLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 exportStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 exportAccess = VK_ACCESS_2_NONE;
+    };
+
+    struct Pass {
+        const char* name;
+        uint32_t firstAccess, accessCount; // range in m_accesses
+        void (*fn)(void* ctx, VkCommandBuffer cmd);
+        void* ctx;
+        bool live = false;
+    };
+
+    void addPass(const char* name, std::initializer_list<RGAccess> accesses, void (*fn)(void* ctx, VkCommandBuffer cmd), void* ctx);
+    void cull();
+    void barrier(Resource& res, VkImageLayout layout, VkPipelineStageFlags2 stage, VkAccessFlags2 readAccess, VkAccessFlags2 writeAccess);
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<RGAccess> m_accesses;
+    LinearArena* m_arena = nullptr;
+
+    BarrierBatch m_barriers;
+};
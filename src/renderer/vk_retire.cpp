@@ -0,0 +1,69 @@
+#include "vk_retire.h"
+
+void RetireQueue::init(VkDevice device, VmaAllocator allocator, BindlessHeap* bindless, BufferSuballocator* buffers) {
+    m_device = device;
+    m_allocator = allocator;
+    m_bindless = bindless;
+    m_buffers = buffers;
+    m_items.reserve(64);
+}
+
+void RetireQueue::push(uint64_t value, const AllocatedImg& img) {
+    add(value, RetireType::ImageView, (uint64_t)img.view);
+    add(value, RetireType::Image, (uint64_t)img.img, img.allocation);
+}
+
+void RetireQueue::push(uint64_t value, const AllocatedBuffer& buffer) {
+    add(value, RetireType::Buffer, (uint64_t)buffer.buffer, buffer.allocation);
+}
+
+void RetireQueue::add(uint64_t value, RetireType type, uint64_t handle, VmaAllocation allocation, uint32_t index) {
+    if (m_head < m_items.size() && value < m_items.back().value) {
+        fmt::print("retire queue values must increase, {} pushed after {}\n", value, m_items.back().value);
+        abort();
+    }
+    m_items.push_back({ value, handle, allocation, index, type });
+}
+
+void RetireQueue::collect(uint64_t completed) {
+    while (m_head < m_items.size() && m_items[m_head].value <= completed) {
+        destroy(m_items[m_head]);
+        m_head++;
+    }
+    if (m_head == m_items.size()) {
+        m_items.clear();
+        m_head = 0;
+    }
+}
+
+void RetireQueue::destroy(const Item& item) {
+    switch (item.type) {
+    case RetireType::Image:
+        vkutil::untrack_allocation(m_allocator, item.allocation);
+        vmaDestroyImage(m_allocator, (VkImage)item.handle, item.allocation);
+        break;
+    case RetireType::Buffer:
+        vkutil::untrack_allocation(m_allocator, item.allocation);
+        vmaDestroyBuffer(m_allocator, (VkBuffer)item.handle, item.allocation);
+        break;
+    case RetireType::ImageView: vkDestroyImageView(m_device, (VkImageView)item.handle, nullptr); break;
+    case RetireType::Sampler: vkDestroySampler(m_device, (VkSampler)item.handle, nullptr); break;
+    case RetireType::Semaphore: vkDestroySemaphore(m_device, (VkSemaphore)item.handle, nullptr); break;
+    case RetireType::Fence: vkDestroyFence(m_device, (VkFence)item.handle, nullptr); break;
+    case RetireType::Swapchain: vkDestroySwapchainKHR(m_device, (VkSwapchainKHR)item.handle, nullptr); break;
+    case RetireType::DescriptorPool: vkDestroyDescriptorPool(m_device, (VkDescriptorPool)item.handle, nullptr); break;
+    case RetireType::DescriptorSetLayout: vkDestroyDescriptorSetLayout(m_device, (VkDescriptorSetLayout)item.handle, nullptr); break;
+    case RetireType::PipelineLayout: vkDestroyPipelineLayout(m_device, (VkPipelineLayout)item.handle, nullptr); break;
+    case RetireType::Pipeline: vkDestroyPipeline(m_device, (VkPipeline)item.handle, nullptr); break;
+    case RetireType::CommandPool: vkDestroyCommandPool(m_device, (VkCommandPool)item.handle, nullptr); break;
+    case RetireType::QueryPool: vkDestroyQueryPool(m_device, (VkQueryPool)item.handle, nullptr); break;
+    case RetireType::BindlessSlot: m_bindless->remove((BindlessType)item.handle, item.index); break;
+    case RetireType::BufferRange: {
+        BufferRange range = {};
+        range.allocation = (VmaVirtualAllocation)item.handle;
+        range.block = item.index;
+        m_buffers->free(range);
+        break;
+    }
+    }
+}
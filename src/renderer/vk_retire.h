@@ -0,0 +1,71 @@
+#pragma once
+#include "vk_common.h"
+#include "vk_bindless.h"
+#include "vk_buffers.h"
+
+enum class RetireType : uint8_t {
+    Image, // handle + allocation
+    Buffer, // handle + allocation
+    ImageView,
+    Sampler,
+    Semaphore,
+    Fence,
+    Swapchain,
+    DescriptorPool,
+    DescriptorSetLayout,
+    PipelineLayout,
+    Pipeline,
+    CommandPool,
+    QueryPool,
+    BindlessSlot, // index into the heap, handle holds the BindlessType
+    BufferRange, // handle is the virtual allocation, index its block
+};
+
+// vulkan objects replaced at runtime, destroyed once the timeline reaches the value they were pushed with.
+// entries are plain data (type, handle, allocation), so pushing never allocates a closure and collecting
+// is one loop over an array. values must be pushed in increasing order, which timeline values always are
+struct RetireQueue {
+    void init(VkDevice device, VmaAllocator allocator, BindlessHeap* bindless, BufferSuballocator* buffers);
+
+    void push(uint64_t value, VkImageView view) { add(value, RetireType::ImageView, (uint64_t)view); }
+    void push(uint64_t value, VkSampler sampler) { add(value, RetireType::Sampler, (uint64_t)sampler); }
+    void push(uint64_t value, VkSemaphore semaphore) { add(value, RetireType::Semaphore, (uint64_t)semaphore); }
+    void push(uint64_t value, VkFence fence) { add(value, RetireType::Fence, (uint64_t)fence); }
+    void push(uint64_t value, VkSwapchainKHR swapchain) { add(value, RetireType::Swapchain, (uint64_t)swapchain); }
+    void push(uint64_t value, VkDescriptorPool pool) { add(value, RetireType::DescriptorPool, (uint64_t)pool); }
+    void push(uint64_t value, VkDescriptorSetLayout layout) { add(value, RetireType::DescriptorSetLayout, (uint64_t)layout); }
+    void push(uint64_t value, VkPipelineLayout layout) { add(value, RetireType::PipelineLayout, (uint64_t)layout); }
+    void push(uint64_t value, VkPipeline pipeline) { add(value, RetireType::Pipeline, (uint64_t)pipeline); }
+    void push(uint64_t value, VkCommandPool pool) { add(value, RetireType::CommandPool, (uint64_t)pool); }
+    void push(uint64_t value, VkQueryPool pool) { add(value, RetireType::QueryPool, (uint64_t)pool); }
+    void push(uint64_t value, const AllocatedImg& img); // view, then img and its memory
+    void push(uint64_t value, const AllocatedBuffer& buffer);
+    void pushBindless(uint64_t value, BindlessType type, uint32_t index) { add(value, RetireType::BindlessSlot, (uint64_t)type, VK_NULL_HANDLE, index); }
+    void push(uint64_t value, const BufferRange& range) { add(value, RetireType::BufferRange, (uint64_t)range.allocation, VK_NULL_HANDLE, range.block); }
+
+    void collect(uint64_t completed);
+    void flush() { collect(UINT64_MAX); }
+
+    size_t size() const { return m_items.size() - m_head; }
+
+private:
+    struct Item {
+        uint64_t value;
+        uint64_t handle;
+        VmaAllocation allocation;
+        uint32_t index;
+        RetireType type;
+    };
+
+    void add(uint64_t value, RetireType type, uint64_t handle, VmaAllocation allocation = VK_NULL_HANDLE, uint32_t index = 0);
+    void destroy(const Item& item);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    BindlessHeap* m_bindless = nullptr;
+    BufferSuballocator* m_buffers = nullptr;
+
+    // consumed from m_head, and cleared once empty so the storage is reused rather than reallocated
+    std::vector<Item> m_items;
+    size_t m_head = 0;
+};
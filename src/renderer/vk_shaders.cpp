@@ -0,0 +1,135 @@
+#include "vk_shaders.h"
+
+// generated from the compiled shaders by shaders/embed_spirv.py
+#include "shaders_embedded.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr uint32_t ARCHIVE_MAGIC = 0x41565053; // "SPVA"
+    constexpr uint32_t ARCHIVE_VERSION = 1;
+
+    struct ArchiveHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;
+    };
+} // namespace
+
+bool ShaderArchive::open(const std::filesystem::path& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0
+        ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+        : nullptr;
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_size = (size_t)size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    // the mapping keeps the file alive, so the descriptor isn't needed past here
+    struct stat st;
+    void* data = fstat(fd, &st) == 0 && st.st_size > 0
+        ? mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+        : MAP_FAILED;
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+    m_size = (size_t)st.st_size;
+#endif
+    m_data = (const uint8_t*)data;
+
+    ArchiveHeader header;
+    if (m_size < sizeof(header)) {
+        fmt::print("shader archive {} is truncated\n", path.string());
+        close();
+        return false;
+    }
+    memcpy(&header, m_data, sizeof(header));
+    if (header.magic != ARCHIVE_MAGIC || header.version != ARCHIVE_VERSION
+        || m_size < sizeof(header) + (size_t)header.count * sizeof(Entry)) {
+        fmt::print("{} isn't a shader archive this build can read\n", path.string());
+        close();
+        return false;
+    }
+
+    // mappings are page aligned and the header is 12 bytes, so the entries are 4 byte aligned
+    m_entries = { (const Entry*)(m_data + sizeof(header)), header.count };
+    for (auto& entry : m_entries) {
+        if (entry.offset % sizeof(uint32_t) || entry.offset + (size_t)entry.words * sizeof(uint32_t) > m_size) {
+            fmt::print("shader archive {} has a bad entry {}\n", path.string(), std::string_view(entry.name, strnlen(entry.name, sizeof(entry.name))));
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShaderArchive::close() {
+    if (!m_data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    munmap((void*)m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_entries = {};
+}
+
+std::span<const uint32_t> ShaderArchive::find(std::string_view name) const {
+    for (auto& entry : m_entries) {
+        if (name == std::string_view(entry.name, strnlen(entry.name, sizeof(entry.name)))) {
+            return { (const uint32_t*)(m_data + entry.offset), entry.words };
+        }
+    }
+    return {};
+}
+
+std::span<const uint32_t> vkutil::embedded_shader(std::string_view name) {
+    for (auto& shader : embedded_shaders::SHADERS) {
+        if (shader.name && name == shader.name) return { shader.code, shader.words };
+    }
+    return {};
+}
+
+std::filesystem::path vkutil::executable_dir() {
+#ifdef _WIN32
+    wchar_t path[MAX_PATH];
+    DWORD length = GetModuleFileNameW(nullptr, path, MAX_PATH);
+    if (length == 0 || length == MAX_PATH) return std::filesystem::current_path();
+    return std::filesystem::path(path).parent_path();
+#else
+    std::error_code err;
+    auto path = std::filesystem::read_symlink("/proc/self/exe", err);
+    if (err) return std::filesystem::current_path();
+    return path.parent_path();
+#endif
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "vk_common.h"
+
+#include <filesystem>
+#include <string_view>
+
+// read only view of a shaders.pak written by shaders/embed_spirv.py. the file is mapped rather than
+// read, so modules are created straight from its pages without a copy
+struct ShaderArchive {
+    // false if the file is missing or isn't an archive, find() then returns nothing
+    bool open(const std::filesystem::path& path);
+    void close();
+
+    // empty if name isn't in the archive
+    std::span<const uint32_t> find(std::string_view name) const;
+
+private:
+    struct Entry {
+        char name[56];
+        uint32_t offset; // bytes from the start of the file
+        uint32_t words;
+    };
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    std::span<const Entry> m_entries;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+namespace vkutil {
+    // spir-v compiled into the binary, empty if name wasn't embedded
+    std::span<const uint32_t> embedded_shader(std::string_view name);
+
+    // directory the engine's executable is in, so data next to it is found whatever the working dir
+    std::filesystem::path executable_dir();
+}
@@ -0,0 +1,187 @@
+#include "vk_upload.h"
+#include "vk_initialisers.h"
+
+void UploadService::init(VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t graphicsQueueFamily) {
+    m_queue = queue;
+    m_submitThread = std::this_thread::get_id();
+    m_queueFamily = queueFamily;
+    m_graphicsQueueFamily = graphicsQueueFamily;
+
+    auto poolInfo = vkinit::cmd_pool_create_info(queueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &m_pool));
+
+    auto timelineTypeInfo = vkinit::semaphore_type_create_info(VK_SEMAPHORE_TYPE_TIMELINE, 0);
+    auto timelineCreateInfo = vkinit::semaphore_create_info();
+    timelineCreateInfo.pNext = &timelineTypeInfo;
+    VK_CHECK(vkCreateSemaphore(device, &timelineCreateInfo, nullptr, &m_timeline));
+}
+
+void UploadService::destroy(VkDevice device) {
+    vkDestroyCommandPool(device, m_pool, nullptr);
+    vkDestroySemaphore(device, m_timeline, nullptr);
+    m_batches.clear();
+    m_pendingAcquires.clear();
+    m_open = -1;
+}
+
+UploadService::Batch& UploadService::openBatch(VkDevice device) {
+    if (m_open >= 0) return m_batches[m_open];
+
+    // reuse the first batch the gpu is done with, or grow
+    uint64_t completed = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, m_timeline, &completed));
+
+    m_open = -1;
+    for (size_t i = 0; i < m_batches.size(); i++) {
+        if (m_batches[i].token <= completed) {
+            m_open = (int32_t)i;
+            break;
+        }
+    }
+    if (m_open < 0) {
+        Batch batch = {};
+        auto allocInfo = vkinit::cmd_buffer_alloc_info(m_pool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &batch.cmd));
+        m_batches.push_back(std::move(batch));
+        m_open = (int32_t)(m_batches.size() - 1);
+    }
+
+    Batch& batch = m_batches[m_open];
+    batch.token = m_nextToken++; // batches are flushed in the order they're opened, so tokens stay ordered
+    batch.acquires.clear();
+    batch.waitSemaphore = VK_NULL_HANDLE;
+    batch.waitValue = 0;
+
+    VK_CHECK(vkResetCommandBuffer(batch.cmd, 0));
+    auto beginInfo = vkinit::cmd_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(batch.cmd, &beginInfo));
+    return batch;
+}
+
+UploadToken UploadService::enqueue(VkDevice device, std::function<void(VkCommandBuffer cmd)>&& fn) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Batch& batch = openBatch(device);
+    fn(batch.cmd);
+    return batch.token;
+}
+
+void UploadService::releaseImage(VkDevice device, VkImage img, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess, VkImageSubresourceRange range) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Batch& batch = openBatch(device);
+
+    // same family needs no ownership transfer, the semaphore wait on the graphics side makes the writes visible
+    bool transfer = m_queueFamily != m_graphicsQueueFamily;
+    uint32_t srcFamily = transfer ? m_queueFamily : VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dstFamily = transfer ? m_graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+
+    BarrierBatch release;
+    release.image(img, oldLayout, newLayout, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, range, srcFamily, dstFamily);
+    release.flush(batch.cmd);
+
+    batch.acquires.push_back(Acquire{
+        .isImage = true, .img = img, .oldLayout = oldLayout, .newLayout = newLayout, .range = range,
+        .dstStage = dstStage, .dstAccess = dstAccess,
+    });
+}
+
+void UploadService::releaseBuffer(VkDevice device, VkBuffer buffer, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+    VkDeviceSize offset, VkDeviceSize size) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Batch& batch = openBatch(device);
+
+    // buffers only need a barrier at all when ownership moves
+    if (m_queueFamily != m_graphicsQueueFamily) {
+        BarrierBatch release;
+        release.buffer(buffer, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, offset, size, m_queueFamily, m_graphicsQueueFamily);
+        release.flush(batch.cmd);
+    }
+
+    batch.acquires.push_back(Acquire{
+        .isImage = false, .buffer = buffer, .offset = offset, .size = size,
+        .dstStage = dstStage, .dstAccess = dstAccess,
+    });
+}
+
+void UploadService::waitFor(VkDevice device, VkSemaphore semaphore, uint64_t value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Batch& batch = openBatch(device);
+
+    // only ever the renderer's timeline, so the latest value covers the earlier ones
+    batch.waitSemaphore = semaphore;
+    batch.waitValue = std::max(batch.waitValue, value);
+}
+
+void UploadService::flush() {
+    if (std::this_thread::get_id() != m_submitThread) {
+        fmt::print("UploadService::flush called off the submitting thread, the queue isn't externally synchronised\n");
+        abort();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_open < 0) return;
+
+    Batch& batch = m_batches[m_open];
+    VK_CHECK(vkEndCommandBuffer(batch.cmd));
+
+    auto cmdInfo = vkinit::cmd_buffer_submit_info(batch.cmd);
+    auto signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timeline, batch.token);
+    auto waitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, batch.waitSemaphore, batch.waitValue);
+    auto submit = vkinit::submit_info(&cmdInfo, &signalInfo, batch.waitSemaphore ? &waitInfo : nullptr);
+    VK_CHECK(vkQueueSubmit2(m_queue, 1, &submit, nullptr));
+
+    m_pendingAcquires.insert(m_pendingAcquires.end(), batch.acquires.begin(), batch.acquires.end());
+    if (!batch.acquires.empty()) m_pendingValue = batch.token;
+    m_open = -1;
+}
+
+uint64_t UploadService::recordAcquires(VkCommandBuffer cmd, VkPipelineStageFlags2& waitStages) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pendingAcquires.empty()) return 0;
+
+    bool transfer = m_queueFamily != m_graphicsQueueFamily;
+
+    BarrierBatch acquire;
+    for (const auto& a : m_pendingAcquires) {
+        waitStages |= a.dstStage;
+        if (!transfer) continue;
+
+        if (a.isImage) {
+            acquire.image(a.img, a.oldLayout, a.newLayout, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, a.dstStage, a.dstAccess,
+                a.range, m_queueFamily, m_graphicsQueueFamily);
+        } else {
+            acquire.buffer(a.buffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, a.dstStage, a.dstAccess,
+                a.offset, a.size, m_queueFamily, m_graphicsQueueFamily);
+        }
+    }
+    acquire.flush(cmd);
+
+    uint64_t value = m_pendingValue;
+    m_pendingAcquires.clear();
+    m_pendingValue = 0;
+    return value;
+}
+
+bool UploadService::isComplete(VkDevice device, UploadToken token) {
+    uint64_t completed = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, m_timeline, &completed));
+    return completed >= token;
+}
+
+void UploadService::wait(VkDevice device, UploadToken token) {
+    // make sure the batch holding the token has actually been submitted. other threads wait for the
+    // renderer to do it, and a timeline wait on a value nothing has submitted yet is allowed
+    if (std::this_thread::get_id() == m_submitThread) {
+        bool open;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            open = m_open >= 0 && m_batches[m_open].token <= token;
+        }
+        if (open) flush();
+    }
+
+    auto waitInfo = vkinit::semaphore_wait_info(&m_timeline, &token);
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "vk_common.h"
+#include "vk_images.h"
+
+#include <mutex>
+#include <thread>
+
+// value of the upload timeline that a batch signals once its commands have run
+using UploadToken = uint64_t;
+
+// batches copy commands from any number of callers into one submit on the transfer queue (or the
+// graphics queue if there isn't a separate one). nothing here blocks unless wait() is called.
+// uploads run on their own timeline, as their submits aren't ordered with the frame submits that
+// signal the renderer's timeline, and a timeline's signals must only ever increase.
+// only the thread that called init submits, as the queue may be the graphics queue the renderer
+// submits and presents on without this service's lock
+struct UploadService {
+    void init(VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t graphicsQueueFamily);
+    void destroy(VkDevice device);
+
+    // records fn into the open batch, safe to call from any thread.
+    // the token completes once the batch has been flushed and has run
+    UploadToken enqueue(VkDevice device, std::function<void(VkCommandBuffer cmd)>&& fn);
+
+    // hands a resource written by the open batch over to the graphics queue, which will use it
+    // at dstStage/dstAccess. the release is recorded into the batch and the matching acquire is
+    // recorded into the next frame by recordAcquires
+    void releaseImage(VkDevice device, VkImage img, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        VkImageSubresourceRange range = vkinit::img_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT));
+    void releaseBuffer(VkDevice device, VkBuffer buffer, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+        VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+    // the open batch won't start until semaphore reaches value, for copies out of resources the graphics
+    // queue is still using. value must already be submitted (or be submitted before the next flush),
+    // and the graphics submit that signals it can't itself wait on this batch
+    void waitFor(VkDevice device, VkSemaphore semaphore, uint64_t value);
+
+    // submits the open batch, if there is one. submitting thread only
+    void flush();
+
+    // records the acquire half of every flushed release into a graphics cmd. returns the upload
+    // timeline value (0 if none) the graphics submit has to wait on, at the returned stages
+    uint64_t recordAcquires(VkCommandBuffer cmd, VkPipelineStageFlags2& waitStages);
+
+    bool isComplete(VkDevice device, UploadToken token);
+    // on the submitting thread this flushes the batch holding the token first, other threads
+    // just block until the renderer's next flush has submitted it and it has run
+    void wait(VkDevice device, UploadToken token);
+
+    VkSemaphore timeline() const { return m_timeline; }
+    uint32_t queueFamily() const { return m_queueFamily; }
+    uint32_t graphicsQueueFamily() const { return m_graphicsQueueFamily; }
+
+private:
+    struct Acquire {
+        bool isImage;
+        VkImage img;
+        VkBuffer buffer;
+        VkImageLayout oldLayout, newLayout;
+        VkImageSubresourceRange range;
+        VkDeviceSize offset, size;
+        VkPipelineStageFlags2 dstStage;
+        VkAccessFlags2 dstAccess;
+    };
+
+    struct Batch {
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        UploadToken token = 0; // value signalled when done, 0 = never submitted
+        VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+        uint64_t waitValue = 0;
+        std::vector<Acquire> acquires;
+    };
+
+    Batch& openBatch(VkDevice device); // expects m_mutex held
+
+    std::mutex m_mutex;
+    std::thread::id m_submitThread;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    uint32_t m_queueFamily = 0, m_graphicsQueueFamily = 0;
+    VkCommandPool m_pool = VK_NULL_HANDLE;
+    VkSemaphore m_timeline = VK_NULL_HANDLE;
+    UploadToken m_nextToken = 1;
+
+    std::vector<Batch> m_batches; // recycled once their token completes
+    int32_t m_open = -1; // index of the batch being recorded
+    std::vector<Acquire> m_pendingAcquires;
+    uint64_t m_pendingValue = 0;
+};